@@ -1,7 +1,10 @@
 // Standard library headers
 #include <chrono>
 #include <cstdint>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <vector>
 
 // Additional library headers
 #include "SDL2/SDL.h"
@@ -11,41 +14,40 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 // Project headers
+#include "framework/frame_pacer.h"
 #include "framework/image.h"
 #include "framework/sdl_instance.h"
 #include "framework/sdl_window.h"
+#include "framework/thread_pool.h"
 #include "framework/uniform_buffer_object.h"
 #include "framework/vertex.h"
 #include "framework/vulkan_buffer.h"
-#include "framework/vulkan_command_buffer_group.h"
 #include "framework/vulkan_command_pool.h"
+#include "framework/vulkan_defragmenter.h"
 #include "framework/vulkan_descriptor_pool.h"
 #include "framework/vulkan_descriptor_set_group.h"
 #include "framework/vulkan_descriptor_set_layout.h"
 #include "framework/vulkan_device.h"
+#include "framework/vulkan_frame_context_group.h"
 #include "framework/vulkan_framebuffer_group.h"
+#include "framework/vulkan_geometry_pool.h"
 #include "framework/vulkan_image.h"
 #include "framework/vulkan_instance.h"
 #include "framework/vulkan_pipeline.h"
+#include "framework/vulkan_pipeline_cache.h"
+#include "framework/vulkan_pipeline_description.h"
+#include "framework/vulkan_pipeline_state_cache.h"
+#include "framework/vulkan_present_policy.h"
 #include "framework/vulkan_render_pass.h"
-#include "framework/vulkan_semaphore.h"
 #include "framework/vulkan_shader_module.h"
 #include "framework/vulkan_surface.h"
 #include "framework/vulkan_swap_chain.h"
+#include "framework/vulkan_transfer_batch.h"
+#include "framework/vulkan_uniform_arena.h"
 #include "framework/vulkan_utility.h"
 
-void draw(VulkanLearning::VulkanDevice& device, VulkanLearning::VulkanSwapChain& swapChain, VulkanLearning::VulkanCommandBufferGroup& commandBuffers)
-{
-    VulkanLearning::VulkanSemaphore imageReadySemaphore(device.getDevice());
-    VulkanLearning::VulkanSemaphore renderFinishedSemaphore(device.getDevice());
-
-    uint32_t imageIndex = device.getNextImageIndex(swapChain.getSwapChain(), imageReadySemaphore.getSemaphore());
-    device.queueSubmit(commandBuffers.getCommandBuffers().at(imageIndex), imageReadySemaphore.getSemaphore(),
-        renderFinishedSemaphore.getSemaphore());
-    device.queuePresent(swapChain.getSwapChain(), renderFinishedSemaphore.getSemaphore(), imageIndex);
-}
-
-void updateUniformBuffer(VulkanLearning::VulkanBuffer& uniformBuffer, const VkExtent2D& swapChainExtent)
+// Returns dynamic offset of the uploaded uniform data
+uint32_t updateUniformBuffer(VulkanLearning::VulkanUniformArena& uniformArena, const VkExtent2D& swapChainExtent)
 {
     static auto startTime = std::chrono::high_resolution_clock::now();
     auto currentTime = std::chrono::high_resolution_clock::now();
@@ -58,12 +60,74 @@ void updateUniformBuffer(VulkanLearning::VulkanBuffer& uniformBuffer, const VkEx
     projection[1][1] *= -1; // Y coordinate of clip coordinates is inverted (OpenGL design)
     ubo.setProjection(projection);
 
-    uniformBuffer.uploadData(&ubo, sizeof(ubo));
+    return uniformArena.uploadData(&ubo, sizeof(ubo));
+}
+
+// Number keys switch between low latency, power saving with frame rate limit and strict vsync presentation
+bool getPresentPolicy(const SDL_Keycode key, VulkanLearning::VulkanPresentPolicy& presentPolicy)
+{
+    const double powerSavingFrameRate = 30.0;
+
+    switch (key)
+    {
+    case SDLK_1:
+        presentPolicy = VulkanLearning::VulkanPresentPolicy(VulkanLearning::VulkanPresentTarget::LowLatency);
+        return true;
+    case SDLK_2:
+        presentPolicy = VulkanLearning::VulkanPresentPolicy(VulkanLearning::VulkanPresentTarget::PowerSaving, powerSavingFrameRate);
+        return true;
+    case SDLK_3:
+        presentPolicy = VulkanLearning::VulkanPresentPolicy(VulkanLearning::VulkanPresentTarget::StrictVsync);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Returns false if the swap chain is out of date or suboptimal and has to be recreated
+bool draw(VulkanLearning::VulkanDevice& device, VulkanLearning::VulkanSwapChain& swapChain, VulkanLearning::VulkanUniformArena& uniformArena,
+    VulkanLearning::VulkanFrameContextGroup& frameContexts,
+    const std::function<void(VulkanLearning::VulkanFrameContext&, uint32_t, uint32_t)>& recordFrame)
+{
+    VulkanLearning::VulkanFrameContext& frame = frameContexts.beginFrame();
+
+    uint32_t imageIndex;
+    const VkResult acquireResult = device.getNextImageIndex(swapChain.getSwapChain(), frame.getImageAvailableSemaphore(), imageIndex);
+
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        return false;
+    }
+
+    // Each frame in flight has its own arena region, beginFrame already waited until the device stopped reading it
+    uniformArena.beginFrame(frameContexts.getFrameIndex());
+    const uint32_t uniformOffset = updateUniformBuffer(uniformArena, swapChain.getExtent());
+    uniformArena.endFrame();
+
+    recordFrame(frame, imageIndex, uniformOffset);
+    const uint64_t submissionValue = device.queueSubmit(frame.getCommandBuffer(), frame.getImageAvailableSemaphore(),
+        swapChain.getRenderFinishedSemaphore(imageIndex));
+    const VkResult presentResult = device.queuePresent(swapChain.getSwapChain(), swapChain.getRenderFinishedSemaphore(imageIndex),
+        imageIndex);
+    frameContexts.endFrame(submissionValue);
+
+    if (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR)
+    {
+        swapChain.markFramePresented(submissionValue);
+    }
+
+    return acquireResult == VK_SUCCESS && presentResult == VK_SUCCESS;
 }
 
 int main(int argc, char* argv[])
 {
     bool quit = false;
+    bool swapChainOutOfDate = false;
+    bool resizePending = false;
+    std::chrono::steady_clock::time_point lastResizeTime;
+    // Resize events arriving within this interval are coalesced into a single swap chain rebuild
+    const std::chrono::milliseconds resizeSettleTime(50);
+    const int minimizedPollInterval = 100;
     VulkanLearning::SdlInstance sdlInstance(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
     VulkanLearning::SdlWindow window("Part 1", 1280, 720, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN);
     SDL_Event event;
@@ -91,92 +155,102 @@ int main(int argc, char* argv[])
     VulkanLearning::VulkanSurface surface(vulkanInstance.getInstance(), window.getWindow());
     VulkanLearning::VulkanDevice device(devices.at(0), VK_QUEUE_GRAPHICS_BIT, {"VK_LAYER_LUNARG_standard_validation"}, {"VK_KHR_swapchain"},
         surface.getSurface());
-    VulkanLearning::VulkanSwapChain swapChain(device.getDevice(), surface.getSurface(), device.getVulkanSwapChainInfo(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    VulkanLearning::VulkanPresentPolicy presentPolicy(VulkanLearning::VulkanPresentTarget::LowLatency);
+    VulkanLearning::FramePacer framePacer(presentPolicy.getFrameRateLimit());
+    VulkanLearning::VulkanSwapChain swapChain(device.getDevice(), device.getSyncObjectPool(), surface.getSurface(),
+        device.getVulkanSwapChainInfo(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, presentPolicy);
     VulkanLearning::VulkanShaderModule vertexShader(device.getDevice(), "demo_vert.spv");
     VulkanLearning::VulkanShaderModule fragmentShader(device.getDevice(), "demo_frag.spv");
     VulkanLearning::VulkanRenderPass renderPass(device.getDevice(), swapChain.getSurfaceFormat().format);
-    VulkanLearning::VulkanDescriptorSetLayout setLayout(device.getDevice());
-    VulkanLearning::VulkanPipeline graphicsPipeline(device.getDevice(), renderPass.getRenderPass(), vertexShader.getShaderModule(),
-        fragmentShader.getShaderModule(), swapChain.getExtent(), vertices.at(0).getVertexInputBindingDescription(),
-        vertices.at(0).getVertexInputAttributeDescriptions(), {setLayout.getDescriptorSetLayout()});
+    VulkanLearning::VulkanDescriptorSetLayout setLayout(device.getDevice(), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+    // Warm starts reuse pipelines compiled by previous runs on the same device and driver
+    VulkanLearning::VulkanPipelineCache pipelineCache(device.getDevice(), device.getPhysicalDeviceProperties(), "pipeline_cache.bin");
+    VulkanLearning::VulkanPipelineStateCache pipelineStateCache(device.getDevice(), pipelineCache.getPipelineCache(),
+        VulkanLearning::ThreadPool::getDefaultWorkerCount());
+
+    const auto attributeDescriptions = vertices.at(0).getVertexInputAttributeDescriptions();
+    VulkanLearning::VulkanPipelineDescription pipelineDescription(vertexShader.getShaderModule(), fragmentShader.getShaderModule(),
+        swapChain.getSurfaceFormat().format);
+    pipelineDescription.setVertexInput({vertices.at(0).getVertexInputBindingDescription()},
+        std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()));
+    pipelineDescription.setLayout(VulkanLearning::VulkanPipelineLayoutDescription({setLayout.getDescriptorSetLayout()}));
+
+    // Pipelines compile on worker threads while the scene is loaded
+    pipelineStateCache.compilePipelines({pipelineDescription}, renderPass.getRenderPass());
+
     VulkanLearning::VulkanFramebufferGroup framebuffers(device.getDevice(), renderPass.getRenderPass(), swapChain.getExtent(),
         swapChain.getImageViews());
     VulkanLearning::VulkanCommandPool commandPool(device.getDevice(), device.getQueueFamilyIndex());
-    VulkanLearning::VulkanCommandBufferGroup commandBuffers(device.getDevice(), commandPool.getCommandPool(),
-        static_cast<uint32_t>(framebuffers.getFramebuffers().size()));
-
-    // Transfer vertex data into staging buffer
-    VulkanLearning::VulkanBuffer stagingVertexBuffer(device.getDevice(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, sizeof(vertices.at(0)) * vertices.size());
-    stagingVertexBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(stagingVertexBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-    stagingVertexBuffer.uploadData(vertices.data(), sizeof(vertices.at(0)) * vertices.size());
-
-    // Transfer vertex data from staging buffer to device buffer
-    VulkanLearning::VulkanCommandPool transferCommandPool(device.getDevice(), device.getQueueFamilyIndex(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-    VulkanLearning::VulkanCommandBufferGroup vertexTransferCommand(device.getDevice(), transferCommandPool.getCommandPool(), 1);
-    VulkanLearning::VulkanBuffer vertexBuffer(device.getDevice(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        sizeof(vertices.at(0)) * vertices.size());
-    vertexBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(vertexBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
-    vertexBuffer.uploadData(stagingVertexBuffer.getBuffer(), sizeof(vertices.at(0)) * vertices.size(),
-        vertexTransferCommand.getCommandBuffers().at(0));
-    device.queueSubmit(vertexTransferCommand.getCommandBuffers().at(0));
-    stagingVertexBuffer.destroyBuffer();
-
-    // Transfer index data into staging buffer
-    VulkanLearning::VulkanBuffer stagingIndexBuffer(device.getDevice(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        sizeof(vertexIndices.at(0)) * vertexIndices.size());
-    stagingIndexBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(stagingIndexBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-    stagingIndexBuffer.uploadData(vertexIndices.data(), sizeof(vertexIndices.at(0)) * vertexIndices.size());
-
-    // Transfer index data from staging buffer to device buffer
-    VulkanLearning::VulkanCommandBufferGroup indexTransferCommand(device.getDevice(), transferCommandPool.getCommandPool(), 1);
-    VulkanLearning::VulkanBuffer indexBuffer(device.getDevice(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        sizeof(vertexIndices.at(0)) * vertexIndices.size());
-    indexBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(indexBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
-    indexBuffer.uploadData(stagingIndexBuffer.getBuffer(), sizeof(vertexIndices.at(0)) * vertexIndices.size(),
-        indexTransferCommand.getCommandBuffers().at(0));
-    device.queueSubmit(indexTransferCommand.getCommandBuffers().at(0));
-    stagingIndexBuffer.destroyBuffer();
-
-    // Create uniform buffer and transfer its data into descriptor set
-    VulkanLearning::VulkanBuffer uniformBuffer(device.getDevice(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(VulkanLearning::UniformBufferObject));
-    uniformBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(uniformBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-    VulkanLearning::VulkanDescriptorPool descriptorPool(device.getDevice());
+    VulkanLearning::ThreadPool threadPool(VulkanLearning::ThreadPool::getDefaultWorkerCount());
+    const uint32_t framesInFlight = 2;
+    VulkanLearning::VulkanFrameContextGroup frameContexts(device.getSyncObjectPool(), device.getGraphicsTimeline(), device.getQueueFamilyIndex(),
+        threadPool, framesInFlight);
+
+    // Record all uploads into a single transfer batch
+    VulkanLearning::VulkanCommandPool transferCommandPool(device.getDevice(), device.getTransferQueueFamilyIndex(),
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    VulkanLearning::VulkanTransferBatch transferBatch(device.getDevice(), transferCommandPool.getCommandPool(), device.getTransferQueueFamilyIndex(),
+        device.getStagingBuffer(), commandPool.getCommandPool(), device.getQueueFamilyIndex());
+
+    // Transfer vertex and index data through staging buffer into the shared geometry buffers
+    const uint32_t geometryVertexCapacity = 64 * 1024;
+    const uint32_t geometryIndexCapacity = 256 * 1024;
+    VulkanLearning::VulkanGeometryPool geometryPool(device.getDevice(), device.getMemoryAllocator(), sizeof(vertices.at(0)),
+        geometryVertexCapacity, geometryIndexCapacity);
+    const std::vector<VulkanLearning::VulkanMesh> meshes =
+    {
+        geometryPool.addMesh(transferBatch, vertices.data(), static_cast<uint32_t>(vertices.size()), vertexIndices.data(),
+            static_cast<uint32_t>(vertexIndices.size()))
+    };
+
+    // Create uniform arena with one region per frame in flight and bind it through a single dynamic descriptor, the number of
+    // regions stays valid when the swap chain is recreated with a different image count
+    const VkDeviceSize uniformFrameSize = 256 * 1024;
+    VulkanLearning::VulkanUniformArena uniformArena(device.getDevice(), device.getMemoryAllocator(), uniformFrameSize,
+        frameContexts.getFramesInFlight(), device.getPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment);
+    VulkanLearning::VulkanDescriptorPool descriptorPool(device.getDevice(), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
     VulkanLearning::VulkanDescriptorSetGroup descriptorSets(device.getDevice(), setLayout.getDescriptorSetLayout(),
         descriptorPool.getDescriptorPool(), 1);
-    descriptorSets.attachUniformBuffer(uniformBuffer.getBuffer(), sizeof(VulkanLearning::UniformBufferObject));
+    descriptorSets.attachUniformBuffer(uniformArena.getBuffer(), sizeof(VulkanLearning::UniformBufferObject),
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 
     // Load texture image
     VulkanLearning::Image texture("texture.jpg");
-    VulkanLearning::VulkanBuffer stagingImageBuffer(device.getDevice(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, texture.getImageSize());
-    stagingImageBuffer.allocateMemory(device.getSuitableMemoryTypeIndex(stagingImageBuffer.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-    stagingImageBuffer.uploadData(texture.getImage(), texture.getImageSize());
     VulkanLearning::VulkanImage textureImage(device.getDevice(), VkExtent3D{static_cast<uint32_t>(texture.getWidth()),
         static_cast<uint32_t>(texture.getHeight()), 1});
-    textureImage.allocateMemory(device.getSuitableMemoryTypeIndex(textureImage.getMemoryRequirements().memoryTypeBits,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
-    VulkanLearning::VulkanCommandBufferGroup imageTransitionCommand(device.getDevice(), transferCommandPool.getCommandPool(), 1);
-    textureImage.transitionLayout(imageTransitionCommand.getCommandBuffers().at(0), device.getQueue(), VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    VulkanLearning::VulkanCommandBufferGroup imageUploadCommand(device.getDevice(), transferCommandPool.getCommandPool(), 1);
-    textureImage.uploadImage(imageUploadCommand.getCommandBuffers().at(0), stagingImageBuffer.getBuffer(),
-        static_cast<uint32_t>(texture.getWidth()), static_cast<uint32_t>(texture.getHeight()));
-    VulkanLearning::VulkanCommandBufferGroup imageSecondTransitionCommand(device.getDevice(), transferCommandPool.getCommandPool(), 1);
-    textureImage.transitionLayout(imageSecondTransitionCommand.getCommandBuffers().at(0), device.getQueue(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    framebuffers.beginRenderPass(commandBuffers.getCommandBuffers(), graphicsPipeline.getPipeline(), {vertexBuffer.getBuffer()},
-        indexBuffer.getBuffer(), vertexIndices.size(), {0}, vertices.size(), graphicsPipeline.getPipelineLayout(),
-        descriptorSets.getDescriptorSets().at(0));
+    textureImage.allocateMemory(device.getMemoryAllocator(), VulkanLearning::VulkanMemoryUsage::GpuOnly);
+    transferBatch.transitionImageLayout(textureImage.getImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    transferBatch.uploadImage(textureImage.getImage(), texture.getImage(), texture.getImageSize(), textureImage.getExtent());
+    transferBatch.releaseImage(textureImage.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Uploads run on the transfer queue, the graphics queue acquires the resources before the first frame uses them
+    transferBatch.submit(device.getTransferTimeline(), device.getGraphicsTimeline());
+
+    // Device local resources are compacted in the background, old handles are kept alive until the graphics timeline passes the
+    // last frame which used them. Geometry handles are fixed up by recording every frame's commands again. The texture is not
+    // sampled by the demo shaders, so no descriptor references it; descriptors of relocated resources would have to be rewritten
+    // whenever step returns true.
+    const VkDeviceSize defragmentationBudget = 4 * 1024 * 1024;
+    VulkanLearning::VulkanDefragmenter defragmenter(device.getDevice(), device.getMemoryAllocator(), commandPool.getCommandPool(),
+        device.getStagingBuffer(), device.getGraphicsTimeline());
+    geometryPool.registerBuffers(defragmenter);
+    defragmenter.addImage(textureImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Materials with equal state receive the same pipeline and layout from the state cache, waits until the pipeline is compiled
+    VulkanLearning::VulkanPipeline graphicsPipeline(pipelineStateCache, renderPass.getRenderPass(), pipelineDescription);
+
+    // Commands are recorded every frame into secondary command buffers on all cores, so the scene can change between frames
+    const auto recordFrame = [&](VulkanLearning::VulkanFrameContext& frame, const uint32_t imageIndex, const uint32_t uniformOffset)
+    {
+        framebuffers.recordRenderPass(frame.getCommandBuffer(), frame.getSecondaryRecorder(), imageIndex, graphicsPipeline.getPipeline(),
+            geometryPool.getVertexBuffer(), geometryPool.getIndexBuffer(), geometryPool.getIndexType(), meshes, graphicsPipeline.getPipelineLayout(),
+            descriptorSets.getDescriptorSets().at(0), uniformOffset);
+    };
 
     while (!quit)
     {
+        framePacer.waitForNextFrame();
+
         while (SDL_PollEvent(&event) != 0)
         {
             if (event.type == SDL_QUIT)
@@ -185,23 +259,8 @@ int main(int argc, char* argv[])
             }
             else if (event.window.event == SDL_WINDOWEVENT_RESIZED)
             {
-                device.waitIdle();
-
-                framebuffers.destroyFramebuffers();
-                commandBuffers.destroyCommandBuffers();
-                graphicsPipeline.destroyPipeline();
-                renderPass.destroyRenderPass();
-                swapChain.destroySwapChain();
-
-                swapChain.reloadSwapChain(device.getVulkanSwapChainInfo());
-                renderPass.reloadRenderPass(swapChain.getSurfaceFormat().format);
-                graphicsPipeline.reloadPipeline(renderPass.getRenderPass(), swapChain.getExtent());
-                framebuffers.reloadFramebuffers(renderPass.getRenderPass(), swapChain.getExtent(), swapChain.getImageViews());
-                commandBuffers.reloadCommandBuffers();
-
-                framebuffers.beginRenderPass(commandBuffers.getCommandBuffers(), graphicsPipeline.getPipeline(), {vertexBuffer.getBuffer()},
-                    indexBuffer.getBuffer(), vertexIndices.size(), {0}, vertices.size(), graphicsPipeline.getPipelineLayout(),
-                    descriptorSets.getDescriptorSets().at(0));
+                resizePending = true;
+                lastResizeTime = std::chrono::steady_clock::now();
             }
             else if (event.type == SDL_KEYDOWN)
             {
@@ -211,15 +270,79 @@ int main(int argc, char* argv[])
                     quit = true;
                     break;
                 default:
-                    // do nothing
+                    // Image count may change with the target, only the framebuffers depend on it and they are rebuilt
+                    if (getPresentPolicy(event.key.keysym.sym, presentPolicy))
+                    {
+                        swapChain.setPresentPolicy(presentPolicy);
+                        framePacer.setFrameRateLimit(presentPolicy.getFrameRateLimit());
+                        framePacer.resetStatistics();
+                        swapChainOutOfDate = true;
+                    }
                     break;
                 }
             }
         }
 
-        draw(device, swapChain, commandBuffers);
-        updateUniformBuffer(uniformBuffer, swapChain.getExtent());
+        framePacer.markInputSample();
+
+        // While the old swap chain can still be presented to, the rebuild waits until the window stops changing size
+        if (resizePending && std::chrono::steady_clock::now() - lastResizeTime >= resizeSettleTime)
+        {
+            swapChainOutOfDate = true;
+        }
+
+        if (swapChainOutOfDate)
+        {
+            const VulkanLearning::VulkanSwapChainInfo swapChainInfo = device.getVulkanSwapChainInfo();
+            const VkExtent2D surfaceExtent = swapChainInfo.getSurfaceCapabilities().currentExtent;
+
+            // Minimized window has no drawable area, the swap chain is recreated once it is restored. Until then the loop sleeps
+            // on the event queue, the timeout covers surfaces which report their new extent only after the restore event.
+            if (surfaceExtent.width == 0 || surfaceExtent.height == 0)
+            {
+                SDL_WaitEventTimeout(nullptr, minimizedPollInterval);
+                continue;
+            }
+
+            // Commands are recorded every frame, so nothing waits for the frames in flight. Their framebuffers are retired until the
+            // graphics timeline passes them, the old swap chain until the first frame presented on the new one has finished.
+            const VkFormat previousFormat = swapChain.getSurfaceFormat().format;
+
+            framebuffers.retireFramebuffers(device.getGraphicsTimeline());
+            swapChain.recreateSwapChain(swapChainInfo);
+
+            // Viewport and scissor are dynamic, so the pipeline is only rebuilt together with the render pass on a format change. The
+            // render pass is still used by the frames in flight, format changes are rare enough to wait for them.
+            if (swapChain.getSurfaceFormat().format != previousFormat)
+            {
+                device.getGraphicsTimeline().waitIdle();
+                graphicsPipeline.destroyPipeline();
+                renderPass.destroyRenderPass();
+                renderPass.reloadRenderPass(swapChain.getSurfaceFormat().format);
+                graphicsPipeline.reloadPipeline(renderPass.getRenderPass(), swapChain.getSurfaceFormat().format);
+            }
+
+            framebuffers.reloadFramebuffers(renderPass.getRenderPass(), swapChain.getExtent(), swapChain.getImageViews());
+            swapChainOutOfDate = false;
+            resizePending = false;
+        }
+
+        // Commands are recorded after the step, so relocated geometry is drawn from its new buffers right away
+        defragmenter.step(defragmentationBudget);
+        swapChainOutOfDate = !draw(device, swapChain, uniformArena, frameContexts, recordFrame);
+        framePacer.markPresentSubmit();
+        framebuffers.releaseRetiredFramebuffers(device.getGraphicsTimeline());
+        swapChain.releaseRetiredSwapChains(device.getGraphicsTimeline());
     }
 
+    device.waitIdle();
+    pipelineCache.save();
+
+    std::cout << "Input to present submit latency: average " << framePacer.getAverageLatency().count() << " us, maximum "
+        << framePacer.getMaxLatency().count() << " us over " << framePacer.getFrameCount() << " frames" << std::endl;
+
+    std::ofstream memoryStatistics("memory_statistics.json");
+    device.getMemoryAllocator().printStatisticsJson(memoryStatistics);
+
     return 0;
 }
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace VulkanLearning
+{
+
+// Limits the frame rate on the host and measures latency from the input sample of a frame to its present submission. The
+// limiter sleeps for most of the remaining frame time and spins for the rest, because sleep granularity of the operating
+// system is usually around a millisecond.
+class FramePacer
+{
+public:
+    explicit FramePacer(const double frameRateLimit) :
+        spinDuration(std::chrono::microseconds(1500)),
+        frameCount(0),
+        lastLatency(0),
+        maxLatency(0),
+        totalLatency(0)
+    {
+        setFrameRateLimit(frameRateLimit);
+        nextFrameTime = Clock::now();
+        inputSampleTime = nextFrameTime;
+    }
+
+    // Frame rate limit of zero disables the limiter
+    void setFrameRateLimit(const double frameRateLimit)
+    {
+        this->frameRateLimit = frameRateLimit;
+        frameInterval = frameRateLimit > 0.0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRateLimit))
+            : Clock::duration::zero();
+        nextFrameTime = Clock::now();
+    }
+
+    // Has to be called before input is sampled, so that the waiting does not add to the latency
+    void waitForNextFrame()
+    {
+        if (frameInterval == Clock::duration::zero())
+        {
+            return;
+        }
+
+        const auto now = Clock::now();
+
+        if (nextFrameTime - now > spinDuration)
+        {
+            std::this_thread::sleep_for(nextFrameTime - now - spinDuration);
+        }
+
+        while (Clock::now() < nextFrameTime)
+        {
+            std::this_thread::yield();
+        }
+
+        // A frame which missed its slot does not make the following frames run faster to catch up
+        nextFrameTime = std::max(nextFrameTime + frameInterval, Clock::now());
+    }
+
+    void markInputSample()
+    {
+        inputSampleTime = Clock::now();
+    }
+
+    void markPresentSubmit()
+    {
+        lastLatency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - inputSampleTime);
+        maxLatency = std::max(maxLatency, lastLatency);
+        totalLatency += lastLatency;
+        frameCount++;
+    }
+
+    void resetStatistics()
+    {
+        frameCount = 0;
+        lastLatency = std::chrono::microseconds(0);
+        maxLatency = std::chrono::microseconds(0);
+        totalLatency = std::chrono::microseconds(0);
+    }
+
+    double getFrameRateLimit() const
+    {
+        return frameRateLimit;
+    }
+
+    uint64_t getFrameCount() const
+    {
+        return frameCount;
+    }
+
+    std::chrono::microseconds getLastLatency() const
+    {
+        return lastLatency;
+    }
+
+    std::chrono::microseconds getMaxLatency() const
+    {
+        return maxLatency;
+    }
+
+    std::chrono::microseconds getAverageLatency() const
+    {
+        if (frameCount == 0)
+        {
+            return std::chrono::microseconds(0);
+        }
+
+        return totalLatency / frameCount;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double frameRateLimit;
+    Clock::duration frameInterval;
+    Clock::duration spinDuration;
+    Clock::time_point nextFrameTime;
+    Clock::time_point inputSampleTime;
+    uint64_t frameCount;
+    std::chrono::microseconds lastLatency;
+    std::chrono::microseconds maxLatency;
+    std::chrono::microseconds totalLatency;
+};
+
+} // namespace VulkanLearning
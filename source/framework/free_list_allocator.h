@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+namespace VulkanLearning
+{
+
+class FreeListAllocator
+{
+public:
+    explicit FreeListAllocator(const uint64_t size) :
+        size(size),
+        freeSize(size)
+    {
+        freeRanges.emplace(0, size);
+    }
+
+    bool allocate(const uint64_t allocationSize, const uint64_t alignment, uint64_t& offset)
+    {
+        auto bestRange = freeRanges.end();
+
+        for (auto range = freeRanges.begin(); range != freeRanges.end(); range++)
+        {
+            const uint64_t padding = alignOffset(range->first, alignment) - range->first;
+
+            if (padding + allocationSize > range->second)
+            {
+                continue;
+            }
+
+            if (bestRange == freeRanges.end() || range->second < bestRange->second)
+            {
+                bestRange = range;
+            }
+        }
+
+        if (bestRange == freeRanges.end())
+        {
+            return false;
+        }
+
+        const uint64_t rangeOffset = bestRange->first;
+        const uint64_t rangeSize = bestRange->second;
+        offset = alignOffset(rangeOffset, alignment);
+        freeRanges.erase(bestRange);
+
+        // alignment padding and the remaining tail go back to the free list
+        if (offset > rangeOffset)
+        {
+            freeRanges.emplace(rangeOffset, offset - rangeOffset);
+        }
+
+        const uint64_t tailSize = rangeOffset + rangeSize - (offset + allocationSize);
+        if (tailSize > 0)
+        {
+            freeRanges.emplace(offset + allocationSize, tailSize);
+        }
+
+        freeSize -= allocationSize;
+        return true;
+    }
+
+    void free(const uint64_t offset, const uint64_t allocationSize)
+    {
+        auto range = freeRanges.emplace(offset, allocationSize).first;
+        freeSize += allocationSize;
+
+        auto nextRange = std::next(range);
+        if (nextRange != freeRanges.end() && range->first + range->second == nextRange->first)
+        {
+            range->second += nextRange->second;
+            freeRanges.erase(nextRange);
+        }
+
+        if (range != freeRanges.begin())
+        {
+            auto previousRange = std::prev(range);
+            if (previousRange->first + previousRange->second == range->first)
+            {
+                previousRange->second += range->second;
+                freeRanges.erase(range);
+            }
+        }
+    }
+
+    static uint64_t alignOffset(const uint64_t offset, const uint64_t alignment)
+    {
+        if (alignment <= 1)
+        {
+            return offset;
+        }
+
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    bool isEmpty() const
+    {
+        return freeSize == size;
+    }
+
+    uint64_t getSize() const
+    {
+        return size;
+    }
+
+    uint64_t getFreeSize() const
+    {
+        return freeSize;
+    }
+
+    uint64_t getLargestFreeRange() const
+    {
+        uint64_t largestRange = 0;
+
+        for (const auto& range : freeRanges)
+        {
+            largestRange = std::max(largestRange, range.second);
+        }
+
+        return largestRange;
+    }
+
+    const std::map<uint64_t, uint64_t>& getFreeRanges() const
+    {
+        return freeRanges;
+    }
+
+private:
+    uint64_t size;
+    uint64_t freeSize;
+    std::map<uint64_t, uint64_t> freeRanges;
+};
+
+} // namespace VulkanLearning
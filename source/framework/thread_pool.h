@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanLearning
+{
+
+// Fixed set of worker threads which split indexed tasks between themselves. The thread calling parallelFor takes part in the
+// work as thread 0, so thread indices range from 0 to getThreadCount() - 1 and can be used to pick per-thread resources.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(const uint32_t workerCount) :
+        job(nullptr),
+        taskCount(0),
+        nextTask(0),
+        activeWorkerCount(0),
+        generation(0),
+        stopping(false)
+    {
+        for (uint32_t i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back([this, i]()
+            {
+                workerLoop(i + 1);
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        jobCondition.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Calls function with every task index from 0 to count - 1 and returns once all of them have finished. The first exception
+    // thrown by a task is rethrown here. Must not be called from multiple threads at the same time.
+    void parallelFor(const size_t count, const std::function<void(size_t, uint32_t)>& function)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &function;
+            taskCount = count;
+            nextTask = 0;
+            activeWorkerCount = static_cast<uint32_t>(workers.size());
+            error = nullptr;
+            ++generation;
+        }
+
+        jobCondition.notify_all();
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finishedCondition.wait(lock, [this]()
+        {
+            return activeWorkerCount == 0;
+        });
+
+        job = nullptr;
+
+        if (error != nullptr)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    uint32_t getThreadCount() const
+    {
+        return static_cast<uint32_t>(workers.size()) + 1;
+    }
+
+    // Leaves one core for the calling thread, hardware concurrency may be reported as 0
+    static uint32_t getDefaultWorkerCount()
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable finishedCondition;
+    const std::function<void(size_t, uint32_t)>* job;
+    size_t taskCount;
+    std::atomic<size_t> nextTask;
+    uint32_t activeWorkerCount;
+    uint64_t generation;
+    bool stopping;
+    std::exception_ptr error;
+
+    void workerLoop(const uint32_t threadIndex)
+    {
+        uint64_t finishedGeneration = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobCondition.wait(lock, [this, finishedGeneration]()
+                {
+                    return stopping || generation != finishedGeneration;
+                });
+
+                if (stopping)
+                {
+                    return;
+                }
+
+                finishedGeneration = generation;
+            }
+
+            runTasks(threadIndex);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            --activeWorkerCount;
+
+            if (activeWorkerCount == 0)
+            {
+                finishedCondition.notify_one();
+            }
+        }
+    }
+
+    void runTasks(const uint32_t threadIndex)
+    {
+        while (true)
+        {
+            const size_t task = nextTask.fetch_add(1);
+
+            if (task >= taskCount)
+            {
+                return;
+            }
+
+            try
+            {
+                (*job)(task, threadIndex);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (error == nullptr)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+};
+
+} // namespace VulkanLearning
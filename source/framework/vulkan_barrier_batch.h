@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Collects memory, buffer and image barriers and records all of them with a single vkCmdPipelineBarrier into a command buffer
+// owned by the caller. Stage masks of the collected barriers are merged, so barriers should only be batched when none of them
+// has to wait for work recorded between their creation and the flush.
+class VulkanBarrierBatch
+{
+public:
+    VulkanBarrierBatch() :
+        sourceStageMask(0),
+        destinationStageMask(0)
+    {}
+
+    void addMemoryBarrier(const VkPipelineStageFlags sourceStages, const VkAccessFlags sourceAccessMask,
+        const VkPipelineStageFlags destinationStages, const VkAccessFlags destinationAccessMask)
+    {
+        const VkMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            sourceAccessMask,
+            destinationAccessMask
+        };
+
+        memoryBarriers.push_back(barrier);
+        addStages(sourceStages, destinationStages);
+    }
+
+    void addBufferBarrier(const VkBufferMemoryBarrier& barrier, const VkPipelineStageFlags sourceStages,
+        const VkPipelineStageFlags destinationStages)
+    {
+        bufferBarriers.push_back(barrier);
+        addStages(sourceStages, destinationStages);
+    }
+
+    void addImageBarrier(const VkImageMemoryBarrier& barrier, const VkPipelineStageFlags sourceStages,
+        const VkPipelineStageFlags destinationStages)
+    {
+        imageBarriers.push_back(barrier);
+        addStages(sourceStages, destinationStages);
+    }
+
+    // Access masks and stages are derived from the layouts
+    void addImageTransition(VkImage image, const VkImageAspectFlags aspectMask, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    {
+        const VkImageMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            nullptr,
+            getImageLayoutAccessMask(oldLayout),
+            getImageLayoutAccessMask(newLayout),
+            oldLayout,
+            newLayout,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            image,
+            VkImageSubresourceRange
+            {
+                aspectMask,
+                0,
+                VK_REMAINING_MIP_LEVELS,
+                0,
+                VK_REMAINING_ARRAY_LAYERS
+            }
+        };
+
+        addImageBarrier(barrier, getImageLayoutPipelineStage(oldLayout), getImageLayoutPipelineStage(newLayout));
+    }
+
+    // Records the collected barriers without clearing them, does nothing if the batch is empty
+    void record(VkCommandBuffer commandBuffer) const
+    {
+        if (isEmpty())
+        {
+            return;
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, getSourceStageMask(), getDestinationStageMask(), 0, static_cast<uint32_t>(memoryBarriers.size()),
+            memoryBarriers.data(), static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+            static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    }
+
+    void flush(VkCommandBuffer commandBuffer)
+    {
+        record(commandBuffer);
+        clear();
+    }
+
+    void clear()
+    {
+        memoryBarriers.clear();
+        bufferBarriers.clear();
+        imageBarriers.clear();
+        sourceStageMask = 0;
+        destinationStageMask = 0;
+    }
+
+    bool isEmpty() const
+    {
+        return getBarrierCount() == 0;
+    }
+
+    size_t getBarrierCount() const
+    {
+        return memoryBarriers.size() + bufferBarriers.size() + imageBarriers.size();
+    }
+
+    VkPipelineStageFlags getSourceStageMask() const
+    {
+        return sourceStageMask != 0 ? sourceStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    }
+
+    VkPipelineStageFlags getDestinationStageMask() const
+    {
+        return destinationStageMask != 0 ? destinationStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    const std::vector<VkMemoryBarrier>& getMemoryBarriers() const
+    {
+        return memoryBarriers;
+    }
+
+    const std::vector<VkBufferMemoryBarrier>& getBufferBarriers() const
+    {
+        return bufferBarriers;
+    }
+
+    const std::vector<VkImageMemoryBarrier>& getImageBarriers() const
+    {
+        return imageBarriers;
+    }
+
+private:
+    std::vector<VkMemoryBarrier> memoryBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    VkPipelineStageFlags sourceStageMask;
+    VkPipelineStageFlags destinationStageMask;
+
+    void addStages(const VkPipelineStageFlags sourceStages, const VkPipelineStageFlags destinationStages)
+    {
+        sourceStageMask |= sourceStages;
+        destinationStageMask |= destinationStages;
+    }
+};
+
+} // namespace VulkanLearning
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include "vulkan/vulkan.h"
+#include "vulkan_memory_allocator.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -14,22 +17,12 @@ public:
         device(device),
         usageFlags(usageFlags),
         bufferSize(bufferSize),
+        memoryAllocator(nullptr),
         memoryAllocated(false),
-        bufferDestroyed(false)
+        bufferDestroyed(false),
+        relocationBuffer(VK_NULL_HANDLE)
     {
-        const VkBufferCreateInfo bufferCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            nullptr,
-            0,
-            bufferSize,
-            usageFlags,
-            VK_SHARING_MODE_EXCLUSIVE,
-            0,
-            nullptr
-        };
-
-        checkVulkanError(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer), "vkCreateBuffer");
+        buffer = createBuffer();
     }
 
     ~VulkanBuffer()
@@ -45,9 +38,16 @@ public:
         vkDestroyBuffer(device, buffer, nullptr);
         if (memoryAllocated)
         {
-            vkFreeMemory(device, bufferMemory, nullptr);
+            memoryAllocator->free(memoryAllocation);
             memoryAllocated = false;
         }
+
+        if (isRelocating())
+        {
+            vkDestroyBuffer(device, relocationBuffer, nullptr);
+            memoryAllocator->free(relocationAllocation);
+            relocationBuffer = VK_NULL_HANDLE;
+        }
         bufferDestroyed = true;
     }
 
@@ -58,32 +58,52 @@ public:
         return requirements;
     }
 
-    void allocateMemory(const uint32_t memoryTypeIndex)
+    void allocateMemory(VulkanMemoryAllocator& allocator, const VulkanMemoryUsage usage)
     {
-        VkMemoryRequirements memoryRequirements = getMemoryRequirements();
-
-        const VkMemoryAllocateInfo memoryAllocateInfo =
-        {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            nullptr,
-            memoryRequirements.size,
-            memoryTypeIndex
-        };
+        allocateMemory(allocator, allocator.findMemoryTypeIndex(getMemoryRequirements(), usage));
+    }
 
-        checkVulkanError(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &bufferMemory), "vkAllocateMemory");
-        checkVulkanError(vkBindBufferMemory(device, buffer, bufferMemory, 0), "vkBindBufferMemory");
+    void allocateMemory(VulkanMemoryAllocator& allocator, const uint32_t memoryTypeIndex)
+    {
+        memoryAllocation = allocator.allocate(getMemoryRequirements(), memoryTypeIndex, VulkanResourceType::Buffer);
+        memoryAllocator = &allocator;
         memoryAllocated = true;
+
+        checkVulkanError(vkBindBufferMemory(device, buffer, memoryAllocation.getMemory(), memoryAllocation.getOffset()), "vkBindBufferMemory");
     }
 
     void uploadData(const void* source, const VkDeviceSize dataSize)
     {
-        void* data;
-        checkVulkanError(vkMapMemory(device, bufferMemory, 0, dataSize, 0, &data), "vkMapMemory");
-        std::memcpy(data, source, dataSize);
-        vkUnmapMemory(device, bufferMemory);
+        uploadData(source, dataSize, 0);
+    }
+
+    void uploadData(const void* source, const VkDeviceSize dataSize, const VkDeviceSize offset)
+    {
+        std::memcpy(static_cast<uint8_t*>(getMappedData()) + offset, source, dataSize);
+        flush(offset, dataSize);
+    }
+
+    void flush(const VkDeviceSize offset, const VkDeviceSize dataSize)
+    {
+        memoryAllocator->flush(memoryAllocation, offset, dataSize);
+    }
+
+    void* getMappedData() const
+    {
+        if (!memoryAllocation.isMapped())
+        {
+            throw std::runtime_error("Buffer memory is not host visible");
+        }
+
+        return memoryAllocation.getMappedData();
     }
 
     void uploadData(VkBuffer sourceBuffer, const VkDeviceSize dataSize, VkCommandBuffer commandBuffer)
+    {
+        uploadData(sourceBuffer, 0, dataSize, commandBuffer);
+    }
+
+    void uploadData(VkBuffer sourceBuffer, const VkDeviceSize sourceOffset, const VkDeviceSize dataSize, VkCommandBuffer commandBuffer)
     {
         const VkCommandBufferBeginInfo commandBufferBeginInfo =
         {
@@ -95,7 +115,7 @@ public:
 
         const VkBufferCopy copyRegion =
         {
-            0,
+            sourceOffset,
             0,
             dataSize
         };
@@ -105,6 +125,50 @@ public:
         checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
     }
 
+    // Records copy of the buffer contents into a new buffer bound to the given allocation, the buffer handle does not change until
+    // completeRelocation is called after the copy has finished
+    void beginRelocation(const VulkanMemoryAllocation& allocation, VkCommandBuffer commandBuffer)
+    {
+        if (isRelocating())
+        {
+            throw std::runtime_error("Buffer is already being relocated");
+        }
+
+        relocationBuffer = createBuffer();
+        relocationAllocation = allocation;
+        checkVulkanError(vkBindBufferMemory(device, relocationBuffer, allocation.getMemory(), allocation.getOffset()), "vkBindBufferMemory");
+
+        const VkBufferCopy copyRegion =
+        {
+            0,
+            0,
+            bufferSize
+        };
+
+        vkCmdCopyBuffer(commandBuffer, buffer, relocationBuffer, 1, &copyRegion);
+    }
+
+    // Switches to the relocated buffer, the previous handle and its memory are returned so they can be released once the device
+    // stops using them
+    void completeRelocation(VkBuffer& retiredBuffer, VulkanMemoryAllocation& retiredAllocation)
+    {
+        retiredBuffer = buffer;
+        retiredAllocation = memoryAllocation;
+        buffer = relocationBuffer;
+        memoryAllocation = relocationAllocation;
+        relocationBuffer = VK_NULL_HANDLE;
+    }
+
+    bool isRelocating() const
+    {
+        return relocationBuffer != VK_NULL_HANDLE;
+    }
+
+    VulkanMemoryAllocator* getMemoryAllocator() const
+    {
+        return memoryAllocator;
+    }
+
     VkDevice getDevice() const
     {
         return device;
@@ -125,14 +189,41 @@ public:
         return buffer;
     }
 
+    VulkanMemoryAllocation getMemoryAllocation() const
+    {
+        return memoryAllocation;
+    }
+
 private:
     VkDevice device;
     VkBufferUsageFlags usageFlags;
     VkDeviceSize bufferSize;
     VkBuffer buffer;
-    VkDeviceMemory bufferMemory;
+    VulkanMemoryAllocator* memoryAllocator;
+    VulkanMemoryAllocation memoryAllocation;
     bool memoryAllocated;
     bool bufferDestroyed;
+    VkBuffer relocationBuffer;
+    VulkanMemoryAllocation relocationAllocation;
+
+    VkBuffer createBuffer() const
+    {
+        const VkBufferCreateInfo bufferCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            nullptr,
+            0,
+            bufferSize,
+            usageFlags,
+            VK_SHARING_MODE_EXCLUSIVE,
+            0,
+            nullptr
+        };
+
+        VkBuffer result;
+        checkVulkanError(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &result), "vkCreateBuffer");
+        return result;
+    }
 };
 
 } // namespace VulkanLearning
@@ -7,6 +7,8 @@
 namespace VulkanLearning
 {
 
+// Command pools are externally synchronized, a pool and the command buffers allocated from it may only be used by one thread at
+// a time. Threads which record in parallel need pools of their own.
 class VulkanCommandPool
 {
 public:
@@ -34,6 +36,12 @@ public:
         vkDestroyCommandPool(device, commandPool, nullptr);
     }
 
+    // Resets all command buffers allocated from the pool, none of them may be pending execution
+    void resetCommandPool()
+    {
+        checkVulkanError(vkResetCommandPool(device, commandPool, 0), "vkResetCommandPool");
+    }
+
     VkDevice getDevice() const
     {
         return device;
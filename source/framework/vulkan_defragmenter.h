@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_buffer.h"
+#include "vulkan_image.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_queue_timeline.h"
+#include "vulkan_staging_buffer.h"
+#include "vulkan_transfer_batch.h"
+
+namespace VulkanLearning
+{
+
+// Incrementally compacts device local memory of the registered buffers and images. Every step records GPU copies of at most
+// the given number of bytes, relocated resources receive their new handles only after their copies have finished and the
+// previous handles are destroyed once the timeline passes the last submission which may still use them, so nothing ever waits
+// on the device.
+//
+// Owners of commands and descriptors which reference registered resources are responsible for updating them when step reports
+// new handles. Commands recorded every frame pick up the new handles by themselves, descriptor sets have to be rewritten.
+class VulkanDefragmenter
+{
+public:
+    // Timeline belongs to the queue which uses the resources, relocation copies are submitted to the same queue
+    explicit VulkanDefragmenter(VkDevice device, VulkanMemoryAllocator& allocator, VkCommandPool commandPool, VulkanStagingBuffer& stagingBuffer,
+        VulkanQueueTimeline& timeline) :
+        device(device),
+        allocator(allocator),
+        commandPool(commandPool),
+        stagingBuffer(stagingBuffer),
+        timeline(timeline)
+    {}
+
+    // Device has to be idle
+    ~VulkanDefragmenter()
+    {
+        if (transferBatch != nullptr)
+        {
+            transferBatch->wait();
+            completeRelocations();
+        }
+
+        releaseRetiredResources(true);
+    }
+
+    void addBuffer(VulkanBuffer& buffer)
+    {
+        buffers.push_back(&buffer);
+    }
+
+    void removeBuffer(VulkanBuffer& buffer)
+    {
+        if (buffer.isRelocating())
+        {
+            finishPendingStep();
+        }
+
+        buffers.erase(std::remove(buffers.begin(), buffers.end(), &buffer), buffers.end());
+    }
+
+    // Layout is the layout which the image is in whenever the defragmenter steps
+    void addImage(VulkanImage& image, const VkImageLayout layout)
+    {
+        images.push_back(std::make_pair(&image, layout));
+    }
+
+    void removeImage(VulkanImage& image)
+    {
+        if (image.isRelocating())
+        {
+            finishPendingStep();
+        }
+
+        images.erase(std::remove_if(images.begin(), images.end(), [&image](const std::pair<VulkanImage*, VkImageLayout>& entry)
+        {
+            return entry.first == &image;
+        }), images.end());
+    }
+
+    // Returns true if some resources received new handles, command buffers, descriptor sets and image views which reference them
+    // have to be updated before their next use
+    bool step(const VkDeviceSize byteBudget)
+    {
+        releaseRetiredResources(false);
+        bool relocated = false;
+
+        if (transferBatch != nullptr)
+        {
+            if (!transferBatch->isComplete())
+            {
+                return false;
+            }
+
+            completeRelocations();
+            relocated = true;
+        }
+
+        recordRelocations(byteBudget);
+        return relocated;
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VulkanQueueTimeline& getTimeline()
+    {
+        return timeline;
+    }
+
+    size_t getRetiredResourceCount() const
+    {
+        return retiredResources.size();
+    }
+
+    bool isStepPending() const
+    {
+        return transferBatch != nullptr;
+    }
+
+private:
+    struct RetiredResource
+    {
+        VkBuffer buffer;
+        VkImage image;
+        VulkanMemoryAllocation allocation;
+        uint64_t retireValue;
+    };
+
+    VkDevice device;
+    VulkanMemoryAllocator& allocator;
+    VkCommandPool commandPool;
+    VulkanStagingBuffer& stagingBuffer;
+    VulkanQueueTimeline& timeline;
+    std::vector<VulkanBuffer*> buffers;
+    std::vector<std::pair<VulkanImage*, VkImageLayout>> images;
+    std::unique_ptr<VulkanTransferBatch> transferBatch;
+    std::vector<RetiredResource> retiredResources;
+
+    bool isMovable(const VulkanMemoryAllocation& allocation, const VkDeviceSize remainingBudget) const
+    {
+        // Host visible memory may be written by the host at any time, so only device local memory is compacted
+        return !allocation.isDedicated() && !allocator.isHostVisible(allocation.getMemoryTypeIndex()) && allocation.getSize() <= remainingBudget;
+    }
+
+    void recordRelocations(VkDeviceSize byteBudget)
+    {
+        const VkBufferUsageFlags copyUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        VulkanMemoryAllocation target;
+
+        for (auto* buffer : buffers)
+        {
+            const VulkanMemoryAllocation allocation = buffer->getMemoryAllocation();
+
+            if (buffer->getMemoryAllocator() != &allocator || (buffer->getUsageFlags() & copyUsage) != copyUsage
+                || !isMovable(allocation, byteBudget)
+                || !allocator.allocateDefragmentationTarget(allocation, buffer->getMemoryRequirements().alignment, target))
+            {
+                continue;
+            }
+
+            buffer->beginRelocation(target, getTransferBatch().getCommandBuffer());
+            byteBudget -= allocation.getSize();
+        }
+
+        for (const auto& entry : images)
+        {
+            const VulkanMemoryAllocation allocation = entry.first->getMemoryAllocation();
+
+            if (entry.first->getMemoryAllocator() != &allocator || !isMovable(allocation, byteBudget)
+                || !allocator.allocateDefragmentationTarget(allocation, entry.first->getMemoryRequirements().alignment, target))
+            {
+                continue;
+            }
+
+            entry.first->beginRelocation(target, getTransferBatch().getCommandBuffer(), entry.second);
+            byteBudget -= allocation.getSize();
+        }
+
+        if (transferBatch != nullptr)
+        {
+            transferBatch->submit(timeline);
+        }
+    }
+
+    VulkanTransferBatch& getTransferBatch()
+    {
+        if (transferBatch == nullptr)
+        {
+            transferBatch = std::make_unique<VulkanTransferBatch>(device, commandPool, stagingBuffer);
+        }
+
+        return *transferBatch;
+    }
+
+    void finishPendingStep()
+    {
+        transferBatch->wait();
+        completeRelocations();
+    }
+
+    // Submissions made before the switch may still use the previous handles, later ones are recorded with the new handles
+    void completeRelocations()
+    {
+        const uint64_t retireValue = timeline.getLastSubmittedValue();
+
+        for (auto* buffer : buffers)
+        {
+            if (buffer->isRelocating())
+            {
+                RetiredResource resource = {VK_NULL_HANDLE, VK_NULL_HANDLE, VulkanMemoryAllocation(), retireValue};
+                buffer->completeRelocation(resource.buffer, resource.allocation);
+                retiredResources.push_back(resource);
+            }
+        }
+
+        for (const auto& entry : images)
+        {
+            if (entry.first->isRelocating())
+            {
+                RetiredResource resource = {VK_NULL_HANDLE, VK_NULL_HANDLE, VulkanMemoryAllocation(), retireValue};
+                entry.first->completeRelocation(resource.image, resource.allocation);
+                retiredResources.push_back(resource);
+            }
+        }
+
+        transferBatch.reset();
+    }
+
+    void releaseRetiredResources(const bool releaseAll)
+    {
+        auto resource = retiredResources.begin();
+
+        while (resource != retiredResources.end())
+        {
+            if (!releaseAll && !timeline.isComplete(resource->retireValue))
+            {
+                resource++;
+                continue;
+            }
+
+            if (resource->buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(device, resource->buffer, nullptr);
+            }
+
+            if (resource->image != VK_NULL_HANDLE)
+            {
+                vkDestroyImage(device, resource->image, nullptr);
+            }
+
+            allocator.free(resource->allocation);
+            resource = retiredResources.erase(resource);
+        }
+    }
+};
+
+} // namespace VulkanLearning
@@ -10,11 +10,15 @@ class VulkanDescriptorPool
 {
 public:
     explicit VulkanDescriptorPool(VkDevice device) :
+        VulkanDescriptorPool(device, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+    {}
+
+    explicit VulkanDescriptorPool(VkDevice device, const VkDescriptorType descriptorType) :
         device(device)
     {
         const VkDescriptorPoolSize poolSize =
         {
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            descriptorType,
             1
         };
 
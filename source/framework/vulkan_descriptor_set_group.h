@@ -31,6 +31,12 @@ public:
     }
 
     void attachUniformBuffer(VkBuffer buffer, const VkDeviceSize bufferSize)
+    {
+        attachUniformBuffer(buffer, bufferSize, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    }
+
+    // For VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC the size is the range visible from each dynamic offset
+    void attachUniformBuffer(VkBuffer buffer, const VkDeviceSize bufferSize, const VkDescriptorType descriptorType)
     {
         const VkDescriptorBufferInfo bufferInfo =
         {
@@ -47,7 +53,7 @@ public:
             0,
             0,
             1,
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            descriptorType,
             nullptr,
             &bufferInfo,
             nullptr
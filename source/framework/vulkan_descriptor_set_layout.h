@@ -10,12 +10,17 @@ class VulkanDescriptorSetLayout
 {
 public:
     explicit VulkanDescriptorSetLayout(VkDevice device) :
-        device(device)
+        VulkanDescriptorSetLayout(device, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+    {}
+
+    explicit VulkanDescriptorSetLayout(VkDevice device, const VkDescriptorType uniformBufferType) :
+        device(device),
+        uniformBufferType(uniformBufferType)
     {
         const VkDescriptorSetLayoutBinding uboLayoutBinding =
         {
             0,
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            uniformBufferType,
             1,
             VK_SHADER_STAGE_VERTEX_BIT,
             nullptr
@@ -48,8 +53,14 @@ public:
         return descriptorSetLayout;
     }
 
+    VkDescriptorType getUniformBufferType() const
+    {
+        return uniformBufferType;
+    }
+
 private:
     VkDevice device;
+    VkDescriptorType uniformBufferType;
     VkDescriptorSetLayout descriptorSetLayout;
 };
 
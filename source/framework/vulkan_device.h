@@ -2,10 +2,15 @@
 
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 #include "vulkan/vulkan.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_queue_timeline.h"
+#include "vulkan_staging_buffer.h"
 #include "vulkan_swap_chain_info.h"
+#include "vulkan_sync_object_pool.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -30,6 +35,21 @@ public:
             throw std::runtime_error("One of the requested device extensions is not present");
         }
 
+        if (!checkTimelineSemaphoreSupport())
+        {
+            throw std::runtime_error("Current device does not support timeline semaphores");
+        }
+
+        // Heap budgets are queried through vkGetPhysicalDeviceMemoryProperties2, which is core since Vulkan 1.1
+        std::vector<const char*> enabledExtensions = extensions;
+        memoryBudgetSupported = getPhysicalDeviceProperties().apiVersion >= VK_API_VERSION_1_1
+            && checkExtensionSupport({VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+
+        if (memoryBudgetSupported)
+        {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
         uint32_t queueFamilyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
 
@@ -65,9 +85,19 @@ public:
             throw std::runtime_error("Current device does not have any suitable queues available");
         }
 
+        transferQueueFamilyIndex = findTransferQueueFamilyIndex(queueFamilies);
+
         const VkPhysicalDeviceFeatures deviceFeatures = {};
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures =
+        {
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            nullptr,
+            VK_TRUE
+        };
+
         const float queuePriority = 1.0f;
-        const VkDeviceQueueCreateInfo deviceQueueCreateInfo =
+        std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+        deviceQueueCreateInfos.push_back(VkDeviceQueueCreateInfo
         {
             VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             nullptr,
@@ -75,52 +105,87 @@ public:
             queueFamilyIndex,
             1,
             &queuePriority
-        };
+        });
+
+        if (hasDedicatedTransferQueue())
+        {
+            deviceQueueCreateInfos.push_back(VkDeviceQueueCreateInfo
+            {
+                VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                nullptr,
+                0,
+                transferQueueFamilyIndex,
+                1,
+                &queuePriority
+            });
+        }
 
         const VkDeviceCreateInfo deviceCreateInfo =
         {
             VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            nullptr,
+            &timelineSemaphoreFeatures,
             0,
-            1,
-            &deviceQueueCreateInfo,
+            static_cast<uint32_t>(deviceQueueCreateInfos.size()),
+            deviceQueueCreateInfos.data(),
             static_cast<uint32_t>(validationLayers.size()),
             validationLayers.data(),
-            static_cast<uint32_t>(extensions.size()),
-            extensions.data(),
+            static_cast<uint32_t>(enabledExtensions.size()),
+            enabledExtensions.data(),
             &deviceFeatures
         };
 
         checkVulkanError(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device), "vkCreateDevice");
         vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+        vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
+        graphicsTimeline = std::make_unique<VulkanQueueTimeline>(device, queue);
+
+        if (hasDedicatedTransferQueue())
+        {
+            transferTimeline = std::make_unique<VulkanQueueTimeline>(device, transferQueue);
+        }
+
+        memoryAllocator = std::make_unique<VulkanMemoryAllocator>(physicalDevice, device, memoryBudgetSupported);
+        syncObjectPool = std::make_unique<VulkanSyncObjectPool>(device);
+        const VkDeviceSize stagingBufferSize = 32 * 1024 * 1024;
+        stagingBuffer = std::make_unique<VulkanStagingBuffer>(device, *memoryAllocator, *syncObjectPool, stagingBufferSize);
     }
 
     ~VulkanDevice()
     {
         checkVulkanError(vkDeviceWaitIdle(device), "vkDeviceWaitIdle");
+        stagingBuffer.reset();
+        syncObjectPool.reset();
+        memoryAllocator.reset();
+        transferTimeline.reset();
+        graphicsTimeline.reset();
         vkDestroyDevice(device, nullptr);
     }
 
+    VkPhysicalDeviceProperties getPhysicalDeviceProperties() const
+    {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        return deviceProperties;
+    }
+
     VkPhysicalDeviceMemoryProperties getPhysicalDeviceMemoryProperties() const
     {
-        VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
-        return deviceMemoryProperties;
+        return memoryAllocator->getMemoryProperties();
     }
 
     uint32_t getSuitableMemoryTypeIndex(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const
     {
-        VkPhysicalDeviceMemoryProperties memoryProperties = getPhysicalDeviceMemoryProperties();
+        return memoryAllocator->findMemoryTypeIndex(typeFilter, properties);
+    }
 
-        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-        {
-            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-            {
-                return i;
-            }
-        }
+    uint32_t getSuitableMemoryTypeIndex(const VkMemoryRequirements& memoryRequirements, const VulkanMemoryUsage usage) const
+    {
+        return memoryAllocator->findMemoryTypeIndex(memoryRequirements, usage);
+    }
 
-        throw std::runtime_error("Current device does not have any suitable memory types available");
+    bool isMemoryBudgetSupported() const
+    {
+        return memoryBudgetSupported;
     }
 
     VulkanSwapChainInfo getVulkanSwapChainInfo() const
@@ -157,49 +222,36 @@ public:
         vkDeviceWaitIdle(device);
     }
 
-    void queueSubmit(VkCommandBuffer commandBuffer)
+    // Submissions return the value of the graphics timeline which is reached once they finish, nothing waits for the queue
+    uint64_t queueSubmit(VkCommandBuffer commandBuffer)
     {
-        const VkSubmitInfo submitInfo =
-        {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            nullptr,
-            0,
-            nullptr,
-            nullptr,
-            1,
-            &commandBuffer,
-            0,
-            nullptr
-        };
-
-        checkVulkanError(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "vkQueueSubmit");
-        vkQueueWaitIdle(queue);
+        return queueSubmit(commandBuffer, VK_NULL_HANDLE);
     }
 
-    void queueSubmit(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore)
+    uint64_t queueSubmit(VkCommandBuffer commandBuffer, VkFence fence)
     {
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-
-        const VkSubmitInfo submitInfo =
-        {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            nullptr,
-            1,
-            &waitSemaphore,
-            waitStages,
-            1,
-            &commandBuffer,
-            1,
-            &signalSemaphore
-        };
+        VulkanSubmission submission;
+        submission.addCommandBuffer(commandBuffer);
+        return graphicsTimeline->submit(submission, fence);
+    }
 
-        checkVulkanError(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "vkQueueSubmit");
+    uint64_t queueSubmit(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore)
+    {
+        return queueSubmit(commandBuffer, waitSemaphore, signalSemaphore, VK_NULL_HANDLE);
     }
 
-    void queuePresent(VkSwapchainKHR swapChain, VkSemaphore waitSemaphore, const uint32_t imageIndex)
+    uint64_t queueSubmit(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence fence)
     {
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        VulkanSubmission submission;
+        submission.addCommandBuffer(commandBuffer);
+        submission.waitSemaphore(waitSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        submission.signalSemaphore(signalSemaphore);
+        return graphicsTimeline->submit(submission, fence);
+    }
 
+    // Returns VK_ERROR_OUT_OF_DATE_KHR or VK_SUBOPTIMAL_KHR when the swap chain has to be recreated
+    VkResult queuePresent(VkSwapchainKHR swapChain, VkSemaphore waitSemaphore, const uint32_t imageIndex)
+    {
         const VkPresentInfoKHR presentInfo =
         {
             VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -212,16 +264,14 @@ public:
             nullptr
         };
 
-        vkQueuePresentKHR(queue, &presentInfo); // error checking not done on purpose
-        vkQueueWaitIdle(queue);
+        return checkSwapChainResult(vkQueuePresentKHR(queue, &presentInfo), "vkQueuePresentKHR");
     }
 
-    uint32_t getNextImageIndex(VkSwapchainKHR swapChain, VkSemaphore signalSemaphore)
+    // Signal semaphore is not signaled when the result is VK_ERROR_OUT_OF_DATE_KHR, no image is acquired in that case
+    VkResult getNextImageIndex(VkSwapchainKHR swapChain, VkSemaphore signalSemaphore, uint32_t& imageIndex)
     {
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), signalSemaphore, VK_NULL_HANDLE, &imageIndex);
-
-        return imageIndex;
+        return checkSwapChainResult(vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), signalSemaphore,
+            VK_NULL_HANDLE, &imageIndex), "vkAcquireNextImageKHR");
     }
 
     VkPhysicalDevice getPhysicalDevice() const
@@ -249,18 +299,138 @@ public:
         return queue;
     }
 
+    uint32_t getTransferQueueFamilyIndex() const
+    {
+        return transferQueueFamilyIndex;
+    }
+
+    // Falls back to the main queue when the device does not expose a separate transfer queue family
+    VkQueue getTransferQueue() const
+    {
+        return transferQueue;
+    }
+
+    bool hasDedicatedTransferQueue() const
+    {
+        return transferQueueFamilyIndex != queueFamilyIndex;
+    }
+
+    VulkanQueueTimeline& getGraphicsTimeline()
+    {
+        return *graphicsTimeline;
+    }
+
+    // Shares the graphics timeline when the device does not expose a separate transfer queue family
+    VulkanQueueTimeline& getTransferTimeline()
+    {
+        if (transferTimeline == nullptr)
+        {
+            return *graphicsTimeline;
+        }
+
+        return *transferTimeline;
+    }
+
     VkSurfaceKHR getSurface() const
     {
         return surface;
     }
 
+    VulkanMemoryAllocator& getMemoryAllocator()
+    {
+        return *memoryAllocator;
+    }
+
+    VulkanStagingBuffer& getStagingBuffer()
+    {
+        return *stagingBuffer;
+    }
+
+    VulkanSyncObjectPool& getSyncObjectPool()
+    {
+        return *syncObjectPool;
+    }
+
 private:
     VkPhysicalDevice physicalDevice;
     VkQueueFlagBits queueFlags;
     VkDevice device;
     uint32_t queueFamilyIndex;
     VkQueue queue;
+    uint32_t transferQueueFamilyIndex;
+    VkQueue transferQueue;
     VkSurfaceKHR surface;
+    bool memoryBudgetSupported;
+    std::unique_ptr<VulkanQueueTimeline> graphicsTimeline;
+    std::unique_ptr<VulkanQueueTimeline> transferTimeline;
+    std::unique_ptr<VulkanMemoryAllocator> memoryAllocator;
+    std::unique_ptr<VulkanSyncObjectPool> syncObjectPool;
+    std::unique_ptr<VulkanStagingBuffer> stagingBuffer;
+
+    // Prefers families dedicated to transfers (usually backed by DMA engines), then any family without graphics support
+    uint32_t findTransferQueueFamilyIndex(const std::vector<VkQueueFamilyProperties>& queueFamilies) const
+    {
+        uint32_t transferFamilyIndex = queueFamilyIndex;
+
+        for (uint32_t i = 0; i < queueFamilies.size(); i++)
+        {
+            const VkQueueFlags familyFlags = queueFamilies.at(i).queueFlags;
+
+            if (i == queueFamilyIndex || queueFamilies.at(i).queueCount == 0 || !(familyFlags & VK_QUEUE_TRANSFER_BIT)
+                || familyFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                continue;
+            }
+
+            if (!(familyFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                return i;
+            }
+
+            if (transferFamilyIndex == queueFamilyIndex)
+            {
+                transferFamilyIndex = i;
+            }
+        }
+
+        return transferFamilyIndex;
+    }
+
+    static VkResult checkSwapChainResult(const VkResult result, const std::string& message)
+    {
+        if (result != VK_ERROR_OUT_OF_DATE_KHR && result != VK_SUBOPTIMAL_KHR)
+        {
+            checkVulkanError(result, message);
+        }
+
+        return result;
+    }
+
+    // Timeline semaphores are core since Vulkan 1.2, but remain an optional feature there
+    bool checkTimelineSemaphoreSupport() const
+    {
+        if (getPhysicalDeviceProperties().apiVersion < VK_API_VERSION_1_2)
+        {
+            return false;
+        }
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures =
+        {
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            nullptr,
+            VK_FALSE
+        };
+
+        VkPhysicalDeviceFeatures2 features =
+        {
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            &timelineSemaphoreFeatures,
+            {}
+        };
+
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        return timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+    }
 
     bool checkExtensionSupport(const std::vector<const char*>& extensions)
     {
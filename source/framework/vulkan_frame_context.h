@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include "vulkan/vulkan.h"
+#include "thread_pool.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_secondary_command_recorder.h"
+#include "vulkan_sync_object_pool.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Image available semaphore, command pools and the graphics timeline value of the last submission of a single frame in flight. The
+// semaphore is taken from the pool once and returned when the context is destroyed, which has to happen with idle device. Render
+// finished semaphores belong to the swap chain images, since the present waiting on them is not covered by the submission value.
+// Commands are recorded anew every frame into transient pools, which are reset as a whole once the previous submission finished.
+class VulkanFrameContext
+{
+public:
+    explicit VulkanFrameContext(VulkanSyncObjectPool& syncObjectPool, const uint32_t queueFamilyIndex, ThreadPool& threadPool) :
+        syncObjectPool(syncObjectPool),
+        imageAvailableSemaphore(syncObjectPool.acquireSemaphore()),
+        commandPool(syncObjectPool.getDevice(), queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT),
+        secondaryRecorder(syncObjectPool.getDevice(), queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, threadPool),
+        submissionValue(0)
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            nullptr,
+            commandPool.getCommandPool(),
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1
+        };
+
+        checkVulkanError(vkAllocateCommandBuffers(getDevice(), &commandBufferAllocateInfo, &commandBuffer), "vkAllocateCommandBuffers");
+    }
+
+    ~VulkanFrameContext()
+    {
+        syncObjectPool.releaseSemaphore(imageAvailableSemaphore);
+    }
+
+    // Must only be called once the previous submission of the frame has finished
+    void resetCommandBuffers()
+    {
+        commandPool.resetCommandPool();
+        secondaryRecorder.reset();
+    }
+
+    void setSubmissionValue(const uint64_t value)
+    {
+        submissionValue = value;
+    }
+
+    VkDevice getDevice() const
+    {
+        return syncObjectPool.getDevice();
+    }
+
+    VkSemaphore getImageAvailableSemaphore() const
+    {
+        return imageAvailableSemaphore;
+    }
+
+    // Primary command buffer of the frame, it is in initial state after the frame has begun
+    VkCommandBuffer getCommandBuffer() const
+    {
+        return commandBuffer;
+    }
+
+    VulkanSecondaryCommandRecorder& getSecondaryRecorder()
+    {
+        return secondaryRecorder;
+    }
+
+    // Zero if the context has not been submitted yet
+    uint64_t getSubmissionValue() const
+    {
+        return submissionValue;
+    }
+
+private:
+    VulkanSyncObjectPool& syncObjectPool;
+    VkSemaphore imageAvailableSemaphore;
+    VulkanCommandPool commandPool;
+    VulkanSecondaryCommandRecorder secondaryRecorder;
+    VkCommandBuffer commandBuffer;
+    uint64_t submissionValue;
+};
+
+} // namespace VulkanLearning
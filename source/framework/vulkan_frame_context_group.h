@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "thread_pool.h"
+#include "vulkan_frame_context.h"
+#include "vulkan_queue_timeline.h"
+#include "vulkan_sync_object_pool.h"
+
+namespace VulkanLearning
+{
+
+// Ring of frame contexts, the host only waits for the graphics timeline value of the context it is about to reuse. Per-frame
+// resources such as uniform arena regions should be keyed by the frame index, which unlike the swap chain image count does
+// not change when the swap chain is recreated.
+class VulkanFrameContextGroup
+{
+public:
+    explicit VulkanFrameContextGroup(VulkanSyncObjectPool& syncObjectPool, VulkanQueueTimeline& timeline, const uint32_t queueFamilyIndex,
+        ThreadPool& threadPool, const uint32_t framesInFlight) :
+        timeline(timeline),
+        frameIndex(0)
+    {
+        for (uint32_t i = 0; i < framesInFlight; i++)
+        {
+            frameContexts.push_back(std::make_unique<VulkanFrameContext>(syncObjectPool, queueFamilyIndex, threadPool));
+        }
+    }
+
+    // Waits for the previous submission of the frame and resets its command buffers for recording
+    VulkanFrameContext& beginFrame()
+    {
+        VulkanFrameContext& frameContext = getCurrentFrame();
+        timeline.wait(frameContext.getSubmissionValue());
+        frameContext.resetCommandBuffers();
+        return frameContext;
+    }
+
+    // Submission value is the graphics timeline value signaled by the frame's submission
+    void endFrame(const uint64_t submissionValue)
+    {
+        getCurrentFrame().setSubmissionValue(submissionValue);
+        frameIndex = (frameIndex + 1) % static_cast<uint32_t>(frameContexts.size());
+    }
+
+    VulkanQueueTimeline& getTimeline()
+    {
+        return timeline;
+    }
+
+    VulkanFrameContext& getCurrentFrame()
+    {
+        return *frameContexts.at(frameIndex);
+    }
+
+    uint32_t getFrameIndex() const
+    {
+        return frameIndex;
+    }
+
+    uint32_t getFramesInFlight() const
+    {
+        return static_cast<uint32_t>(frameContexts.size());
+    }
+
+private:
+    VulkanQueueTimeline& timeline;
+    uint32_t frameIndex;
+    std::vector<std::unique_ptr<VulkanFrameContext>> frameContexts;
+};
+
+} // namespace VulkanLearning
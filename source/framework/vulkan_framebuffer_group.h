@@ -2,8 +2,14 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <vector>
 #include "vulkan/vulkan.h"
+#include "vulkan_mesh.h"
+#include "vulkan_push_constants.h"
+#include "vulkan_queue_timeline.h"
+#include "vulkan_secondary_command_recorder.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -23,14 +29,42 @@ public:
 
     ~VulkanFramebufferGroup()
     {
+        for (const auto& retired : retiredFramebuffers)
+        {
+            destroyFramebuffers(retired.framebuffers);
+        }
+
         destroyFramebuffers();
     }
 
     void destroyFramebuffers()
     {
-        for (size_t i = 0; i < framebuffers.size(); i++)
+        destroyFramebuffers(framebuffers);
+        framebuffers.clear();
+    }
+
+    // Frames submitted so far may still render into the current framebuffers, so they are destroyed only once the timeline reaches
+    // the last submitted value. New framebuffers have to be created with reloadFramebuffers.
+    void retireFramebuffers(const VulkanQueueTimeline& timeline)
+    {
+        retiredFramebuffers.push_back(RetiredFramebuffers{framebuffers, timeline.getLastSubmittedValue()});
+        framebuffers.clear();
+    }
+
+    void releaseRetiredFramebuffers(VulkanQueueTimeline& timeline)
+    {
+        auto retired = retiredFramebuffers.begin();
+
+        while (retired != retiredFramebuffers.end())
         {
-            vkDestroyFramebuffer(device, framebuffers.at(i), nullptr);
+            if (!timeline.isComplete(retired->retireValue))
+            {
+                retired++;
+                continue;
+            }
+
+            destroyFramebuffers(retired->framebuffers);
+            retired = retiredFramebuffers.erase(retired);
         }
     }
 
@@ -44,100 +78,193 @@ public:
     void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
         const std::vector<VkDeviceSize>& offsets, const size_t numberOfVertices)
     {
-        for (size_t i = 0; i < commandBuffers.size(); i++)
+        recordInlineRenderPasses(commandBuffers, pipeline, [&](VkCommandBuffer commandBuffer, const size_t)
         {
-            const VkCommandBufferBeginInfo commandBufferBeginInfo =
-            {
-                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                nullptr,
-                VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-                nullptr
-            };
+            bindVertexBuffers(commandBuffer, vertexBuffers, offsets);
+            vkCmdDraw(commandBuffer, static_cast<uint32_t>(numberOfVertices), 1, 0, 0);
+        });
+    }
 
-            checkVulkanError(vkBeginCommandBuffer(commandBuffers.at(i), &commandBufferBeginInfo), "vkBeginCommandBuffer");
+    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
+        VkBuffer indexBuffer, const size_t indexCount, const std::vector<VkDeviceSize>& offsets, const size_t numberOfVertices)
+    {
+        beginRenderPass(commandBuffers, pipeline, vertexBuffers, indexBuffer, indexCount, offsets, numberOfVertices, VK_NULL_HANDLE,
+            VK_NULL_HANDLE, std::vector<uint32_t>{});
+    }
 
-            VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
+        VkBuffer indexBuffer, const size_t indexCount, const std::vector<VkDeviceSize>& offsets, const size_t numberOfVertices,
+        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+    {
+        beginRenderPass(commandBuffers, pipeline, vertexBuffers, indexBuffer, indexCount, offsets, numberOfVertices, pipelineLayout, descriptorSet,
+            std::vector<uint32_t>{});
+    }
 
-            const VkRenderPassBeginInfo renderPassBeginInfo =
+    // Command buffer i binds the descriptor set with dynamic offset i, if there are any. Without a descriptor set nothing is bound.
+    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
+        VkBuffer indexBuffer, const size_t indexCount, const std::vector<VkDeviceSize>& offsets, const size_t,
+        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const std::vector<uint32_t>& dynamicOffsets)
+    {
+        recordInlineRenderPasses(commandBuffers, pipeline, [&](VkCommandBuffer commandBuffer, const size_t framebufferIndex)
+        {
+            if (descriptorSet != VK_NULL_HANDLE)
             {
-                VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                nullptr,
-                renderPass,
-                framebuffers.at(i),
-                VkRect2D
-                {
-                    {0, 0},
-                    extent
-                },
-                1,
-                &clearColor
-            };
+                bindDescriptorSet(commandBuffer, pipelineLayout, descriptorSet, dynamicOffsets, framebufferIndex);
+            }
 
-            vkCmdBeginRenderPass(commandBuffers.at(i), &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(commandBuffers.at(i), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bindVertexBuffers(commandBuffer, vertexBuffers, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indexCount), 1, 0, 0, 0);
+        });
+    }
 
-            if (vertexBuffers.size() > 0)
+    // All meshes are drawn from the same vertex and index buffer, which are bound only once
+    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, VkBuffer vertexBuffer, VkBuffer indexBuffer,
+        const VkIndexType indexType, const std::vector<VulkanMesh>& meshes, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet,
+        const std::vector<uint32_t>& dynamicOffsets)
+    {
+        recordInlineRenderPasses(commandBuffers, pipeline, [&](VkCommandBuffer commandBuffer, const size_t framebufferIndex)
+        {
+            bindDescriptorSet(commandBuffer, pipelineLayout, descriptorSet, dynamicOffsets, framebufferIndex);
+
+            const VkDeviceSize vertexBufferOffset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+            for (const auto& mesh : meshes)
             {
-                vkCmdBindVertexBuffers(commandBuffers.at(i), 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+                vkCmdDrawIndexed(commandBuffer, mesh.getIndexCount(), 1, mesh.getFirstIndex(), static_cast<int32_t>(mesh.getVertexOffset()), 0);
             }
+        });
+    }
 
-            vkCmdDraw(commandBuffers.at(i), static_cast<uint32_t>(numberOfVertices), 1, 0, 0);
+    // Meshes are split between the threads of the recorder, which record one secondary command buffer per thread and framebuffer
+    // in parallel. Dynamic state is not inherited by secondary command buffers, so each of them sets viewport and scissor itself.
+    // The secondary command buffers are not simultaneous use, so a primary command buffer must not be pending more than once.
+    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VulkanSecondaryCommandRecorder& recorder, VkPipeline pipeline,
+        VkBuffer vertexBuffer, VkBuffer indexBuffer, const VkIndexType indexType, const std::vector<VulkanMesh>& meshes,
+        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const std::vector<uint32_t>& dynamicOffsets)
+    {
+        if (commandBuffers.size() > framebuffers.size())
+        {
+            throw std::runtime_error("More command buffers than framebuffers");
+        }
 
-            vkCmdEndRenderPass(commandBuffers.at(i));
-            checkVulkanError(vkEndCommandBuffer(commandBuffers.at(i)), "vkEndCommandBuffer");
+        const std::vector<VkFramebuffer> usedFramebuffers(framebuffers.begin(), framebuffers.begin() + commandBuffers.size());
+        const auto secondaryCommandBuffers = recordMeshes(recorder, usedFramebuffers, pipeline, vertexBuffer, indexBuffer, indexType, meshes,
+            pipelineLayout, descriptorSet, dynamicOffsets, nullptr);
+
+        for (size_t i = 0; i < commandBuffers.size(); i++)
+        {
+            executeRenderPass(commandBuffers.at(i), framebuffers.at(i), 0, secondaryCommandBuffers.at(i));
         }
     }
 
-    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
-        VkBuffer indexBuffer, const size_t indexCount, const std::vector<VkDeviceSize>& offsets, const size_t numberOfVertices)
+    // Records the frame's commands for a single swap chain image, the command buffer is submitted once and recorded again next frame
+    void recordRenderPass(VkCommandBuffer commandBuffer, VulkanSecondaryCommandRecorder& recorder, const uint32_t imageIndex,
+        VkPipeline pipeline, VkBuffer vertexBuffer, VkBuffer indexBuffer, const VkIndexType indexType, const std::vector<VulkanMesh>& meshes,
+        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const uint32_t dynamicOffset)
     {
-        for (size_t i = 0; i < commandBuffers.size(); i++)
+        const auto secondaryCommandBuffers = recordMeshes(recorder, {framebuffers.at(imageIndex)}, pipeline, vertexBuffer, indexBuffer,
+            indexType, meshes, pipelineLayout, descriptorSet, {dynamicOffset}, nullptr);
+        executeRenderPass(commandBuffer, framebuffers.at(imageIndex), VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            secondaryCommandBuffers.at(0));
+    }
+
+    // Same as above, every mesh additionally receives its own draw data through push constants right before it is drawn
+    template <typename T>
+    void recordRenderPass(VkCommandBuffer commandBuffer, VulkanSecondaryCommandRecorder& recorder, const uint32_t imageIndex,
+        VkPipeline pipeline, VkBuffer vertexBuffer, VkBuffer indexBuffer, const VkIndexType indexType, const std::vector<VulkanMesh>& meshes,
+        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const uint32_t dynamicOffset,
+        const VulkanPushConstants<T>& pushConstants, const std::vector<T>& drawData)
+    {
+        if (drawData.size() != meshes.size())
         {
-            const VkCommandBufferBeginInfo commandBufferBeginInfo =
-            {
-                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                nullptr,
-                VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-                nullptr
-            };
+            throw std::runtime_error("Draw data count does not match mesh count");
+        }
 
-            checkVulkanError(vkBeginCommandBuffer(commandBuffers.at(i), &commandBufferBeginInfo), "vkBeginCommandBuffer");
-            VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+        const auto secondaryCommandBuffers = recordMeshes(recorder, {framebuffers.at(imageIndex)}, pipeline, vertexBuffer, indexBuffer,
+            indexType, meshes, pipelineLayout, descriptorSet, {dynamicOffset}, [&](VkCommandBuffer meshCommandBuffer, const size_t meshIndex)
+        {
+            pushConstants.push(meshCommandBuffer, pipelineLayout, drawData.at(meshIndex));
+        });
+        executeRenderPass(commandBuffer, framebuffers.at(imageIndex), VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            secondaryCommandBuffers.at(0));
+    }
 
-            const VkRenderPassBeginInfo renderPassBeginInfo =
-            {
-                VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                nullptr,
-                renderPass,
-                framebuffers.at(i),
-                VkRect2D
-                {
-                    {0, 0},
-                    extent
-                },
-                1,
-                &clearColor
-            };
+    VkDevice getDevice() const
+    {
+        return device;
+    }
 
-            vkCmdBeginRenderPass(commandBuffers.at(i), &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(commandBuffers.at(i), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    VkRenderPass getRenderPass() const
+    {
+        return renderPass;
+    }
 
-            if (vertexBuffers.size() > 0)
-            {
-                vkCmdBindVertexBuffers(commandBuffers.at(i), 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
-            }
+    VkExtent2D getExtent() const
+    {
+        return extent;
+    }
 
-            vkCmdBindIndexBuffer(commandBuffers.at(i), indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-            vkCmdDrawIndexed(commandBuffers.at(i), static_cast<uint32_t>(indexCount), 1, 0, 0, 0);
+    std::vector<VkFramebuffer> getFramebuffers() const
+    {
+        return framebuffers;
+    }
 
-            vkCmdEndRenderPass(commandBuffers.at(i));
-            checkVulkanError(vkEndCommandBuffer(commandBuffers.at(i)), "vkEndCommandBuffer");
+    size_t getRetiredFramebufferGroupCount() const
+    {
+        return retiredFramebuffers.size();
+    }
+
+private:
+    struct RetiredFramebuffers
+    {
+        std::vector<VkFramebuffer> framebuffers;
+        uint64_t retireValue;
+    };
+
+    VkDevice device;
+    VkRenderPass renderPass;
+    VkExtent2D extent;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<RetiredFramebuffers> retiredFramebuffers;
+
+    void destroyFramebuffers(const std::vector<VkFramebuffer>& framebuffersToDestroy) const
+    {
+        for (const auto framebuffer : framebuffersToDestroy)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
         }
     }
 
-    void beginRenderPass(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline, const std::vector<VkBuffer>& vertexBuffers,
-        VkBuffer indexBuffer, const size_t indexCount, const std::vector<VkDeviceSize>& offsets, const size_t numberOfVertices,
-        VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+    void setViewportAndScissor(VkCommandBuffer commandBuffer) const
+    {
+        const VkViewport viewport =
+        {
+            0.0f,
+            0.0f,
+            static_cast<float>(extent.width),
+            static_cast<float>(extent.height),
+            0.0f,
+            1.0f
+        };
+
+        const VkRect2D scissor =
+        {
+            VkOffset2D{0, 0},
+            extent
+        };
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    // Command buffer i renders into framebuffer i, recordDraws records everything between binding the pipeline and ending the pass.
+    // The command buffers are not simultaneous use, a command buffer may only be submitted again once its previous submission has
+    // finished.
+    void recordInlineRenderPasses(const std::vector<VkCommandBuffer>& commandBuffers, VkPipeline pipeline,
+        const std::function<void(VkCommandBuffer, size_t)>& recordDraws) const
     {
         for (size_t i = 0; i < commandBuffers.size(); i++)
         {
@@ -145,7 +272,7 @@ public:
             {
                 VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
                 nullptr,
-                VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+                0,
                 nullptr
             };
 
@@ -169,46 +296,108 @@ public:
 
             vkCmdBeginRenderPass(commandBuffers.at(i), &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
             vkCmdBindPipeline(commandBuffers.at(i), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-            vkCmdBindDescriptorSets(commandBuffers.at(i), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-            if (vertexBuffers.size() > 0)
-            {
-                vkCmdBindVertexBuffers(commandBuffers.at(i), 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
-            }
-
-            vkCmdBindIndexBuffer(commandBuffers.at(i), indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-            vkCmdDrawIndexed(commandBuffers.at(i), static_cast<uint32_t>(indexCount), 1, 0, 0, 0);
+            setViewportAndScissor(commandBuffers.at(i));
+            recordDraws(commandBuffers.at(i), i);
 
             vkCmdEndRenderPass(commandBuffers.at(i));
             checkVulkanError(vkEndCommandBuffer(commandBuffers.at(i)), "vkEndCommandBuffer");
         }
     }
 
-    VkDevice getDevice() const
+    void bindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet,
+        const std::vector<uint32_t>& dynamicOffsets, const size_t framebufferIndex) const
     {
-        return device;
+        if (dynamicOffsets.empty())
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        }
+        else
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1,
+                &dynamicOffsets.at(framebufferIndex));
+        }
     }
 
-    VkRenderPass getRenderPass() const
+    void bindVertexBuffers(VkCommandBuffer commandBuffer, const std::vector<VkBuffer>& vertexBuffers,
+        const std::vector<VkDeviceSize>& offsets) const
     {
-        return renderPass;
+        if (vertexBuffers.size() > 0)
+        {
+            vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+        }
     }
 
-    VkExtent2D getExtent() const
+    // Dynamic offset i is used for framebuffer i, if there are any
+    std::vector<std::vector<VkCommandBuffer>> recordMeshes(VulkanSecondaryCommandRecorder& recorder,
+        const std::vector<VkFramebuffer>& targetFramebuffers, VkPipeline pipeline, VkBuffer vertexBuffer, VkBuffer indexBuffer,
+        const VkIndexType indexType, const std::vector<VulkanMesh>& meshes, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet,
+        const std::vector<uint32_t>& dynamicOffsets, const std::function<void(VkCommandBuffer, size_t)>& recordDrawData) const
     {
-        return extent;
+        const size_t taskCount = std::max<size_t>(1, std::min<size_t>(recorder.getThreadCount(), meshes.size()));
+
+        return recorder.record(renderPass, targetFramebuffers, taskCount,
+            [&](VkCommandBuffer commandBuffer, const size_t framebufferIndex, const size_t taskIndex)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            setViewportAndScissor(commandBuffer);
+
+            bindDescriptorSet(commandBuffer, pipelineLayout, descriptorSet, dynamicOffsets, framebufferIndex);
+
+            const VkDeviceSize vertexBufferOffset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+            const size_t firstMesh = meshes.size() * taskIndex / taskCount;
+            const size_t lastMesh = meshes.size() * (taskIndex + 1) / taskCount;
+
+            for (size_t j = firstMesh; j < lastMesh; j++)
+            {
+                const VulkanMesh& mesh = meshes.at(j);
+
+                if (recordDrawData)
+                {
+                    recordDrawData(commandBuffer, j);
+                }
+
+                vkCmdDrawIndexed(commandBuffer, mesh.getIndexCount(), 1, mesh.getFirstIndex(), static_cast<int32_t>(mesh.getVertexOffset()), 0);
+            }
+        });
     }
 
-    std::vector<VkFramebuffer> getFramebuffers() const
+    void executeRenderPass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, const VkCommandBufferUsageFlags usageFlags,
+        const std::vector<VkCommandBuffer>& secondaryCommandBuffers) const
     {
-        return framebuffers;
-    }
+        const VkCommandBufferBeginInfo commandBufferBeginInfo =
+        {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            nullptr,
+            usageFlags,
+            nullptr
+        };
 
-private:
-    VkDevice device;
-    VkRenderPass renderPass;
-    VkExtent2D extent;
-    std::vector<VkFramebuffer> framebuffers;
+        checkVulkanError(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "vkBeginCommandBuffer");
+        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+
+        const VkRenderPassBeginInfo renderPassBeginInfo =
+        {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            nullptr,
+            renderPass,
+            framebuffer,
+            VkRect2D
+            {
+                {0, 0},
+                extent
+            },
+            1,
+            &clearColor
+        };
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+        vkCmdEndRenderPass(commandBuffer);
+        checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+    }
 
     void initializeFramebufferGroup(const std::vector<VkImageView>& imageViews)
     {
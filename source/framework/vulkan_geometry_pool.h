@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include "vulkan/vulkan.h"
+#include "free_list_allocator.h"
+#include "vulkan_buffer.h"
+#include "vulkan_defragmenter.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_mesh.h"
+#include "vulkan_transfer_batch.h"
+
+namespace VulkanLearning
+{
+
+// Shared device local vertex and index buffers, meshes are sub-allocated from them in units of vertices and indices so
+// a whole scene renders with a single vertex and index buffer binding
+class VulkanGeometryPool
+{
+public:
+    explicit VulkanGeometryPool(VkDevice device, VulkanMemoryAllocator& allocator, const uint32_t vertexStride, const uint32_t vertexCapacity,
+        const uint32_t indexCapacity) :
+        device(device),
+        vertexStride(vertexStride),
+        vertexBuffer(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            static_cast<VkDeviceSize>(vertexStride) * vertexCapacity),
+        indexBuffer(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            sizeof(uint16_t) * static_cast<VkDeviceSize>(indexCapacity)),
+        vertexRanges(vertexCapacity),
+        indexRanges(indexCapacity)
+    {
+        vertexBuffer.allocateMemory(allocator, VulkanMemoryUsage::GpuOnly);
+        indexBuffer.allocateMemory(allocator, VulkanMemoryUsage::GpuOnly);
+    }
+
+    // Records upload of the mesh data into the batch, the mesh can be drawn once the batch has been submitted
+    VulkanMesh addMesh(VulkanTransferBatch& transferBatch, const void* vertices, const uint32_t vertexCount, const uint16_t* indices,
+        const uint32_t indexCount)
+    {
+        uint64_t vertexOffset;
+        if (!vertexRanges.allocate(vertexCount, 1, vertexOffset))
+        {
+            throw std::runtime_error("Geometry pool does not have enough space for mesh vertices");
+        }
+
+        uint64_t firstIndex;
+        if (!indexRanges.allocate(indexCount, 1, firstIndex))
+        {
+            vertexRanges.free(vertexOffset, vertexCount);
+            throw std::runtime_error("Geometry pool does not have enough space for mesh indices");
+        }
+
+        const VkDeviceSize vertexByteOffset = vertexOffset * vertexStride;
+        const VkDeviceSize vertexByteSize = static_cast<VkDeviceSize>(vertexCount) * vertexStride;
+        const VkDeviceSize indexByteOffset = firstIndex * sizeof(uint16_t);
+        const VkDeviceSize indexByteSize = indexCount * sizeof(uint16_t);
+
+        transferBatch.uploadBuffer(vertexBuffer.getBuffer(), vertexByteOffset, vertices, vertexByteSize);
+        transferBatch.uploadBuffer(indexBuffer.getBuffer(), indexByteOffset, indices, indexByteSize);
+        transferBatch.releaseBuffer(vertexBuffer.getBuffer(), vertexByteOffset, vertexByteSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        transferBatch.releaseBuffer(indexBuffer.getBuffer(), indexByteOffset, indexByteSize, VK_ACCESS_INDEX_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+        return VulkanMesh(static_cast<uint32_t>(vertexOffset), vertexCount, static_cast<uint32_t>(firstIndex), indexCount);
+    }
+
+    // Device must not be using the mesh anymore
+    void removeMesh(const VulkanMesh& mesh)
+    {
+        vertexRanges.free(mesh.getVertexOffset(), mesh.getVertexCount());
+        indexRanges.free(mesh.getFirstIndex(), mesh.getIndexCount());
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    uint32_t getVertexStride() const
+    {
+        return vertexStride;
+    }
+
+    // Buffer handles change when the defragmenter relocates them, so they have to be queried again whenever commands are recorded.
+    // Defragmenter must not outlive the pool.
+    void registerBuffers(VulkanDefragmenter& defragmenter)
+    {
+        defragmenter.addBuffer(vertexBuffer);
+        defragmenter.addBuffer(indexBuffer);
+    }
+
+    VkBuffer getVertexBuffer() const
+    {
+        return vertexBuffer.getBuffer();
+    }
+
+    VkBuffer getIndexBuffer() const
+    {
+        return indexBuffer.getBuffer();
+    }
+
+    VkIndexType getIndexType() const
+    {
+        return VK_INDEX_TYPE_UINT16;
+    }
+
+    const FreeListAllocator& getVertexRanges() const
+    {
+        return vertexRanges;
+    }
+
+    const FreeListAllocator& getIndexRanges() const
+    {
+        return indexRanges;
+    }
+
+private:
+    VkDevice device;
+    uint32_t vertexStride;
+    VulkanBuffer vertexBuffer;
+    VulkanBuffer indexBuffer;
+    FreeListAllocator vertexRanges;
+    FreeListAllocator indexRanges;
+};
+
+} // namespace VulkanLearning
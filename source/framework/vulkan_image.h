@@ -3,6 +3,9 @@
 #include <cstdint>
 #include <vector>
 #include "vulkan/vulkan.h"
+#include "vulkan_barrier_batch.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_queue_timeline.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -13,28 +16,12 @@ class VulkanImage
 public:
     explicit VulkanImage(VkDevice device, const VkExtent3D& imageExtent) :
         device(device),
-        memoryAllocated(false)
+        extent(imageExtent),
+        memoryAllocator(nullptr),
+        memoryAllocated(false),
+        relocationImage(VK_NULL_HANDLE)
     {
-        const VkImageCreateInfo imageInfo =
-        {
-            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_IMAGE_TYPE_2D,
-            VK_FORMAT_R8G8B8A8_UNORM,
-            imageExtent,
-            1,
-            1,
-            VK_SAMPLE_COUNT_1_BIT,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            0,
-            nullptr,
-            VK_IMAGE_LAYOUT_UNDEFINED
-        };
-
-        checkVulkanError(vkCreateImage(device, &imageInfo, nullptr, &image), "vkCreateImage");
+        image = createImage();
     }
 
     ~VulkanImage()
@@ -43,9 +30,15 @@ public:
 
         if (memoryAllocated)
         {
-            vkFreeMemory(device, imageMemory, nullptr);
+            memoryAllocator->free(memoryAllocation);
             memoryAllocated = false;
         }
+
+        if (isRelocating())
+        {
+            vkDestroyImage(device, relocationImage, nullptr);
+            memoryAllocator->free(relocationAllocation);
+        }
     }
 
     VkMemoryRequirements getMemoryRequirements() const
@@ -55,24 +48,63 @@ public:
         return requirements;
     }
 
-    void allocateMemory(const uint32_t memoryTypeIndex)
+    bool prefersDedicatedAllocation() const
     {
-        VkMemoryRequirements memoryRequirements = getMemoryRequirements();
+        VkMemoryDedicatedRequirements dedicatedRequirements =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+            nullptr,
+            VK_FALSE,
+            VK_FALSE
+        };
+
+        VkMemoryRequirements2 requirements =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+            &dedicatedRequirements,
+            VkMemoryRequirements{}
+        };
 
-        const VkMemoryAllocateInfo memoryAllocateInfo =
+        const VkImageMemoryRequirementsInfo2 requirementsInfo =
         {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
             nullptr,
-            memoryRequirements.size,
-            memoryTypeIndex
+            image
         };
 
-        checkVulkanError(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &imageMemory), "vkAllocateMemory");
-        checkVulkanError(vkBindImageMemory(device, image, imageMemory, 0), "vkBindImageMemory");
+        vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+        return dedicatedRequirements.prefersDedicatedAllocation == VK_TRUE || dedicatedRequirements.requiresDedicatedAllocation == VK_TRUE;
+    }
+
+    void allocateMemory(VulkanMemoryAllocator& allocator, const VulkanMemoryUsage usage)
+    {
+        allocateMemory(allocator, allocator.findMemoryTypeIndex(getMemoryRequirements(), usage), false);
+    }
+
+    void allocateMemory(VulkanMemoryAllocator& allocator, const uint32_t memoryTypeIndex)
+    {
+        allocateMemory(allocator, memoryTypeIndex, false);
+    }
+
+    // Images for which the driver prefers or requires a dedicated allocation always receive one
+    void allocateMemory(VulkanMemoryAllocator& allocator, const uint32_t memoryTypeIndex, const bool dedicated)
+    {
+        const bool useDedicated = dedicated || prefersDedicatedAllocation();
+        memoryAllocation = allocator.allocate(getMemoryRequirements(), memoryTypeIndex, VulkanResourceType::Image, useDedicated,
+            useDedicated ? image : VK_NULL_HANDLE);
+        memoryAllocator = &allocator;
         memoryAllocated = true;
+
+        checkVulkanError(vkBindImageMemory(device, image, memoryAllocation.getMemory(), memoryAllocation.getOffset()), "vkBindImageMemory");
     }
 
     void uploadImage(VkCommandBuffer commandBuffer, VkBuffer sourceBuffer, uint32_t imageWidth, uint32_t imageHeight)
+    {
+        uploadImage(commandBuffer, sourceBuffer, 0, imageWidth, imageHeight);
+    }
+
+    void uploadImage(VkCommandBuffer commandBuffer, VkBuffer sourceBuffer, const VkDeviceSize sourceOffset, uint32_t imageWidth,
+        uint32_t imageHeight)
     {
         const VkCommandBufferBeginInfo commandBufferBeginInfo =
         {
@@ -84,7 +116,7 @@ public:
 
         const VkBufferImageCopy copyRegion =
         {
-            0,
+            sourceOffset,
             0,
             0,
             VkImageSubresourceLayers
@@ -113,7 +145,16 @@ public:
         checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
     }
 
-    void transitionLayout(VkCommandBuffer commandBuffer, VkQueue queue, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    // Adds the transition to a batch which the caller records into its own command buffer together with other barriers
+    void transitionLayout(VulkanBarrierBatch& barriers, const VkImageLayout oldLayout, const VkImageLayout newLayout) const
+    {
+        barriers.addImageTransition(image, VK_IMAGE_ASPECT_COLOR_BIT, oldLayout, newLayout);
+    }
+
+    // Returns timeline value which is reached once the transition has finished, the command buffer must not be reused before that.
+    // Submits on its own, prefer the batched overload when more than a single image is transitioned.
+    uint64_t transitionLayout(VkCommandBuffer commandBuffer, VulkanQueueTimeline& timeline, const VkImageLayout oldLayout,
+        const VkImageLayout newLayout)
     {
         const VkCommandBufferBeginInfo commandBufferBeginInfo =
         {
@@ -123,27 +164,158 @@ public:
             nullptr
         };
 
-        const VkSubmitInfo submitInfo =
+        checkVulkanError(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "vkBeginCommandBuffer");
+        recordLayoutTransition(commandBuffer, image, oldLayout, newLayout);
+        checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+
+        VulkanSubmission submission;
+        submission.addCommandBuffer(commandBuffer);
+        return timeline.submit(submission);
+    }
+
+    // Records copy of the image contents into a new image bound to the given allocation, both images are left in the given layout
+    // and the image handle does not change until completeRelocation is called after the copy has finished
+    void beginRelocation(const VulkanMemoryAllocation& allocation, VkCommandBuffer commandBuffer, const VkImageLayout layout)
+    {
+        if (isRelocating())
         {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            throw std::runtime_error("Image is already being relocated");
+        }
+
+        relocationImage = createImage();
+        relocationAllocation = allocation;
+        checkVulkanError(vkBindImageMemory(device, relocationImage, allocation.getMemory(), allocation.getOffset()), "vkBindImageMemory");
+
+        VulkanBarrierBatch barriers;
+        transitionLayout(barriers, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        barriers.addImageTransition(relocationImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        barriers.flush(commandBuffer);
+
+        recordRelocationCopy(commandBuffer);
+
+        transitionLayout(barriers, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout);
+        barriers.addImageTransition(relocationImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+        barriers.flush(commandBuffer);
+    }
+
+    // Switches to the relocated image, the previous handle and its memory are returned so they can be released once the device
+    // stops using them. Image views of the previous image have to be recreated.
+    void completeRelocation(VkImage& retiredImage, VulkanMemoryAllocation& retiredAllocation)
+    {
+        retiredImage = image;
+        retiredAllocation = memoryAllocation;
+        image = relocationImage;
+        memoryAllocation = relocationAllocation;
+        relocationImage = VK_NULL_HANDLE;
+    }
+
+    bool isRelocating() const
+    {
+        return relocationImage != VK_NULL_HANDLE;
+    }
+
+    VulkanMemoryAllocator* getMemoryAllocator() const
+    {
+        return memoryAllocator;
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkImage getImage() const
+    {
+        return image;
+    }
+
+    VkExtent3D getExtent() const
+    {
+        return extent;
+    }
+
+    VulkanMemoryAllocation getMemoryAllocation() const
+    {
+        return memoryAllocation;
+    }
+
+private:
+    VkDevice device;
+    VkImage image;
+    VkExtent3D extent;
+    VulkanMemoryAllocator* memoryAllocator;
+    VulkanMemoryAllocation memoryAllocation;
+    bool memoryAllocated;
+    VkImage relocationImage;
+    VulkanMemoryAllocation relocationAllocation;
+
+    VkImage createImage() const
+    {
+        const VkImageCreateInfo imageInfo =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             nullptr,
             0,
-            nullptr,
-            nullptr,
+            VK_IMAGE_TYPE_2D,
+            VK_FORMAT_R8G8B8A8_UNORM,
+            extent,
+            1,
             1,
-            &commandBuffer,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_SHARING_MODE_EXCLUSIVE,
             0,
-            nullptr
+            nullptr,
+            VK_IMAGE_LAYOUT_UNDEFINED
         };
 
-        checkVulkanError(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "vkBeginCommandBuffer");
-        
-        VkImageMemoryBarrier barrier =
+        VkImage result;
+        checkVulkanError(vkCreateImage(device, &imageInfo, nullptr, &result), "vkCreateImage");
+        return result;
+    }
+
+    void recordRelocationCopy(VkCommandBuffer commandBuffer) const
+    {
+        const VkImageSubresourceLayers subresource =
         {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            nullptr,
+            VK_IMAGE_ASPECT_COLOR_BIT,
             0,
             0,
+            1
+        };
+
+        const VkImageCopy copyRegion =
+        {
+            subresource,
+            VkOffset3D
+            {
+                0,
+                0,
+                0
+            },
+            subresource,
+            VkOffset3D
+            {
+                0,
+                0,
+                0
+            },
+            extent
+        };
+
+        vkCmdCopyImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, relocationImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+            &copyRegion);
+    }
+
+    static void recordLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    {
+        const VkImageMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            nullptr,
+            getImageLayoutAccessMask(oldLayout),
+            getImageLayoutAccessMask(newLayout),
             oldLayout,
             newLayout,
             VK_QUEUE_FAMILY_IGNORED,
@@ -159,50 +331,9 @@ public:
             }
         };
 
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else
-        {
-            throw std::invalid_argument("Unsupported image layout transition");
-        }
-
-        vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
-        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(queue);
-    }
-
-    VkDevice getDevice() const
-    {
-        return device;
+        vkCmdPipelineBarrier(commandBuffer, getImageLayoutPipelineStage(oldLayout), getImageLayoutPipelineStage(newLayout), 0, 0, nullptr, 0,
+            nullptr, 1, &barrier);
     }
-
-    VkImage getImage() const
-    {
-        return image;
-    }
-
-private:
-    VkDevice device;
-    VkImage image;
-    VkDeviceMemory imageMemory;
-    bool memoryAllocated;
 };
 
 } // namespace VulkanLearning
@@ -34,7 +34,7 @@ public:
             VK_MAKE_VERSION(0, 1, 0),
             "",
             VK_MAKE_VERSION(0, 0, 0),
-            VK_API_VERSION_1_0
+            VK_API_VERSION_1_2
         };
 
         const VkInstanceCreateInfo instanceCreateInfo =
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include "vulkan/vulkan.h"
+
+namespace VulkanLearning
+{
+
+enum class VulkanResourceType
+{
+    Buffer,
+    Image
+};
+
+// Describes how the memory is going to be accessed, the allocator picks the best memory type for it
+enum class VulkanMemoryUsage
+{
+    // Written by transfers or rendering, never touched by the host
+    GpuOnly,
+    // Written once by the host and read by the device, e.g. staging buffers
+    CpuToGpu,
+    // Written by the device and read back by the host
+    GpuToCpu,
+    // Rewritten by the host every frame and read directly by the device, e.g. uniform buffers
+    Dynamic
+};
+
+class VulkanMemoryAllocation
+{
+public:
+    VulkanMemoryAllocation() :
+        VulkanMemoryAllocation(VK_NULL_HANDLE, 0, 0, 0, VulkanResourceType::Buffer, false, nullptr)
+    {}
+
+    explicit VulkanMemoryAllocation(VkDeviceMemory memory, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t memoryTypeIndex,
+        const VulkanResourceType resourceType, const bool dedicated, void* mappedData) :
+        memory(memory),
+        offset(offset),
+        size(size),
+        memoryTypeIndex(memoryTypeIndex),
+        resourceType(resourceType),
+        dedicated(dedicated),
+        mappedData(mappedData)
+    {}
+
+    VkDeviceMemory getMemory() const
+    {
+        return memory;
+    }
+
+    VkDeviceSize getOffset() const
+    {
+        return offset;
+    }
+
+    VkDeviceSize getSize() const
+    {
+        return size;
+    }
+
+    uint32_t getMemoryTypeIndex() const
+    {
+        return memoryTypeIndex;
+    }
+
+    VulkanResourceType getResourceType() const
+    {
+        return resourceType;
+    }
+
+    bool isDedicated() const
+    {
+        return dedicated;
+    }
+
+    bool isMapped() const
+    {
+        return mappedData != nullptr;
+    }
+
+    // Pointer to the first byte of the allocation, valid for the whole lifetime of host visible allocations
+    void* getMappedData() const
+    {
+        return mappedData;
+    }
+
+private:
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    VulkanResourceType resourceType;
+    bool dedicated;
+    void* mappedData;
+};
+
+} // namespace VulkanLearning
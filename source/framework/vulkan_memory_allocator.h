@@ -0,0 +1,683 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "free_list_allocator.h"
+#include "vulkan_memory_allocation.h"
+#include "vulkan_memory_statistics.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+class VulkanMemoryBlock
+{
+public:
+    explicit VulkanMemoryBlock(VkDevice device, const VkDeviceSize blockSize, const uint32_t memoryTypeIndex, const bool hostVisible) :
+        device(device),
+        memoryTypeIndex(memoryTypeIndex),
+        mappedData(nullptr),
+        ranges(blockSize)
+    {
+        const VkMemoryAllocateInfo memoryAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            nullptr,
+            blockSize,
+            memoryTypeIndex
+        };
+
+        checkVulkanError(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory), "vkAllocateMemory");
+
+        if (hostVisible)
+        {
+            mapMemory(device, memory, mappedData);
+        }
+    }
+
+    // Memory is freed if mapping fails, so a failed allocation never leaks
+    static void mapMemory(VkDevice device, VkDeviceMemory memory, void*& mappedData)
+    {
+        const VkResult result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mappedData);
+
+        if (result != VK_SUCCESS)
+        {
+            vkFreeMemory(device, memory, nullptr);
+        }
+
+        checkVulkanError(result, "vkMapMemory");
+    }
+
+    ~VulkanMemoryBlock()
+    {
+        // freeing the memory implicitly unmaps it
+        vkFreeMemory(device, memory, nullptr);
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    uint32_t getMemoryTypeIndex() const
+    {
+        return memoryTypeIndex;
+    }
+
+    VkDeviceMemory getMemory() const
+    {
+        return memory;
+    }
+
+    void* getMappedData(const VkDeviceSize offset) const
+    {
+        if (mappedData == nullptr)
+        {
+            return nullptr;
+        }
+
+        return static_cast<uint8_t*>(mappedData) + offset;
+    }
+
+    FreeListAllocator& getRanges()
+    {
+        return ranges;
+    }
+
+    const FreeListAllocator& getRanges() const
+    {
+        return ranges;
+    }
+
+private:
+    VkDevice device;
+    uint32_t memoryTypeIndex;
+    VkDeviceMemory memory;
+    void* mappedData;
+    FreeListAllocator ranges;
+};
+
+class VulkanMemoryAllocator
+{
+public:
+    static const VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+
+    explicit VulkanMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const bool memoryBudgetSupported) :
+        VulkanMemoryAllocator(physicalDevice, device, memoryBudgetSupported, defaultBlockSize)
+    {}
+
+    explicit VulkanMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, const bool memoryBudgetSupported,
+        const VkDeviceSize preferredBlockSize) :
+        physicalDevice(physicalDevice),
+        device(device),
+        memoryBudgetSupported(memoryBudgetSupported),
+        memoryProperties(queryMemoryProperties(physicalDevice)),
+        preferredBlockSize(preferredBlockSize),
+        statistics(memoryProperties)
+    {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        nonCoherentAtomSize = std::max<VkDeviceSize>(1, deviceProperties.limits.nonCoherentAtomSize);
+
+        // Buffers and images live in separate blocks, so bufferImageGranularity never has to be considered
+        bufferBlocks.resize(memoryProperties.memoryTypeCount);
+        imageBlocks.resize(memoryProperties.memoryTypeCount);
+        heapBudgets.resize(memoryProperties.memoryHeapCount);
+        heapUsages.resize(memoryProperties.memoryHeapCount);
+        budgetAllocatedHeapSizes.resize(memoryProperties.memoryHeapCount, 0);
+        updateBudget();
+    }
+
+    VulkanMemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, const VulkanMemoryUsage usage,
+        const VulkanResourceType resourceType)
+    {
+        return allocate(memoryRequirements, findMemoryTypeIndex(memoryRequirements, usage), resourceType, false);
+    }
+
+    VulkanMemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, const uint32_t memoryTypeIndex,
+        const VulkanResourceType resourceType)
+    {
+        return allocate(memoryRequirements, memoryTypeIndex, resourceType, false);
+    }
+
+    VulkanMemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, const uint32_t memoryTypeIndex,
+        const VulkanResourceType resourceType, const bool dedicated)
+    {
+        return allocate(memoryRequirements, memoryTypeIndex, resourceType, dedicated, VK_NULL_HANDLE);
+    }
+
+    // Memory allocated for a dedicated image is bound to that image only, which lets the driver place it optimally
+    VulkanMemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, const uint32_t memoryTypeIndex,
+        const VulkanResourceType resourceType, const bool dedicated, VkImage dedicatedImage)
+    {
+        if (memoryTypeIndex >= memoryProperties.memoryTypeCount || (memoryRequirements.memoryTypeBits & (1 << memoryTypeIndex)) == 0)
+        {
+            throw std::runtime_error("Requested memory type is not compatible with the resource");
+        }
+
+        const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+        VkDeviceSize size = memoryRequirements.size;
+        VkDeviceSize alignment = memoryRequirements.alignment;
+
+        // Flushed ranges of non-coherent memory have to be aligned to nonCoherentAtomSize, so allocations are padded to whole atoms
+        if (!isCoherent(memoryTypeIndex))
+        {
+            size = FreeListAllocator::alignOffset(size, nonCoherentAtomSize);
+            alignment = std::max(alignment, nonCoherentAtomSize);
+        }
+
+        // Size of memory dedicated to an image has to match its requirements exactly
+        if (dedicatedImage != VK_NULL_HANDLE)
+        {
+            updateBudget();
+            return allocateDedicated(memoryRequirements.size, findMemoryTypeIndexWithinBudget(memoryRequirements.memoryTypeBits,
+                memoryTypeIndex, memoryRequirements.size), resourceType, dedicatedImage);
+        }
+
+        if (dedicated || size > blockSize / 2)
+        {
+            updateBudget();
+            return allocateDedicated(size, findMemoryTypeIndexWithinBudget(memoryRequirements.memoryTypeBits, memoryTypeIndex, size),
+                resourceType, VK_NULL_HANDLE);
+        }
+
+        std::vector<std::unique_ptr<VulkanMemoryBlock>>& blocks = getBlocks(memoryTypeIndex, resourceType);
+        VkDeviceSize offset;
+
+        for (auto& block : blocks)
+        {
+            if (block->getRanges().allocate(size, alignment, offset))
+            {
+                statistics.recordAllocation(memoryTypeIndex, resourceType, size);
+                return VulkanMemoryAllocation(block->getMemory(), offset, size, memoryTypeIndex, resourceType, false,
+                    block->getMappedData(offset));
+            }
+        }
+
+        updateBudget();
+
+        // A whole new block would push the heap over its budget, allocate only what is needed
+        if (!isWithinBudget(getHeapIndex(memoryTypeIndex), blockSize))
+        {
+            return allocateDedicated(size, findMemoryTypeIndexWithinBudget(memoryRequirements.memoryTypeBits, memoryTypeIndex, size),
+                resourceType, VK_NULL_HANDLE);
+        }
+
+        blocks.push_back(std::make_unique<VulkanMemoryBlock>(device, blockSize, memoryTypeIndex, isHostVisible(memoryTypeIndex)));
+        statistics.recordBlockAllocation(memoryTypeIndex, resourceType, blockSize);
+        if (!blocks.back()->getRanges().allocate(size, alignment, offset))
+        {
+            throw std::runtime_error("Unable to sub-allocate memory from a new memory block");
+        }
+
+        statistics.recordAllocation(memoryTypeIndex, resourceType, size);
+        return VulkanMemoryAllocation(blocks.back()->getMemory(), offset, size, memoryTypeIndex, resourceType, false,
+            blocks.back()->getMappedData(offset));
+    }
+
+    void free(const VulkanMemoryAllocation& allocation)
+    {
+        if (allocation.isDedicated())
+        {
+            vkFreeMemory(device, allocation.getMemory(), nullptr);
+            statistics.recordFree(allocation.getMemoryTypeIndex(), allocation.getResourceType(), allocation.getSize());
+            statistics.recordBlockFree(allocation.getMemoryTypeIndex(), allocation.getResourceType(), allocation.getSize());
+            return;
+        }
+
+        std::vector<std::unique_ptr<VulkanMemoryBlock>>& blocks = getBlocks(allocation.getMemoryTypeIndex(), allocation.getResourceType());
+
+        for (auto block = blocks.begin(); block != blocks.end(); block++)
+        {
+            if ((*block)->getMemory() != allocation.getMemory())
+            {
+                continue;
+            }
+
+            (*block)->getRanges().free(allocation.getOffset(), allocation.getSize());
+            statistics.recordFree(allocation.getMemoryTypeIndex(), allocation.getResourceType(), allocation.getSize());
+
+            // One empty block per pool is kept around to avoid allocation churn
+            if ((*block)->getRanges().isEmpty() && blocks.size() > 1)
+            {
+                statistics.recordBlockFree(allocation.getMemoryTypeIndex(), allocation.getResourceType(), (*block)->getRanges().getSize());
+                blocks.erase(block);
+            }
+            return;
+        }
+
+        throw std::runtime_error("Memory allocation does not belong to this allocator");
+    }
+
+    // Moves are only proposed out of the least used block of a pool and into fuller blocks of the same pool, so the emptiest
+    // block drains and is released once its last allocation is freed
+    bool allocateDefragmentationTarget(const VulkanMemoryAllocation& allocation, const VkDeviceSize alignment, VulkanMemoryAllocation& target)
+    {
+        if (allocation.isDedicated())
+        {
+            return false;
+        }
+
+        std::vector<std::unique_ptr<VulkanMemoryBlock>>& blocks = getBlocks(allocation.getMemoryTypeIndex(), allocation.getResourceType());
+        VulkanMemoryBlock* sourceBlock = nullptr;
+        VulkanMemoryBlock* emptiestBlock = nullptr;
+
+        for (const auto& block : blocks)
+        {
+            if (block->getMemory() == allocation.getMemory())
+            {
+                sourceBlock = block.get();
+            }
+
+            if (emptiestBlock == nullptr || getUsedSize(*block) < getUsedSize(*emptiestBlock))
+            {
+                emptiestBlock = block.get();
+            }
+        }
+
+        if (blocks.size() < 2 || sourceBlock == nullptr || sourceBlock != emptiestBlock)
+        {
+            return false;
+        }
+
+        std::vector<VulkanMemoryBlock*> targetBlocks;
+        for (const auto& block : blocks)
+        {
+            if (block.get() != sourceBlock)
+            {
+                targetBlocks.push_back(block.get());
+            }
+        }
+
+        std::sort(targetBlocks.begin(), targetBlocks.end(), [](const VulkanMemoryBlock* first, const VulkanMemoryBlock* second)
+        {
+            return getUsedSize(*first) > getUsedSize(*second);
+        });
+
+        VkDeviceSize offset;
+        for (auto* block : targetBlocks)
+        {
+            if (block->getRanges().allocate(allocation.getSize(), alignment, offset))
+            {
+                statistics.recordAllocation(allocation.getMemoryTypeIndex(), allocation.getResourceType(), allocation.getSize());
+                target = VulkanMemoryAllocation(block->getMemory(), offset, allocation.getSize(), allocation.getMemoryTypeIndex(),
+                    allocation.getResourceType(), false, block->getMappedData(offset));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    uint32_t findMemoryTypeIndex(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const
+    {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Current device does not have any suitable memory types available");
+    }
+
+    // Picks the memory type with the most preferred and the fewest unwanted properties for the given usage, heaps which would
+    // exceed their budget are skipped
+    uint32_t findMemoryTypeIndex(const VkMemoryRequirements& memoryRequirements, const VulkanMemoryUsage usage) const
+    {
+        VkMemoryPropertyFlags requiredFlags;
+        VkMemoryPropertyFlags preferredFlags;
+        VkMemoryPropertyFlags unwantedFlags;
+        getMemoryUsageFlags(usage, requiredFlags, preferredFlags, unwantedFlags);
+
+        bool typeFound = false;
+        uint32_t bestTypeIndex = 0;
+        int bestScore = 0;
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[i].propertyFlags;
+
+            if ((memoryRequirements.memoryTypeBits & (1 << i)) == 0 || (propertyFlags & requiredFlags) != requiredFlags
+                || !isWithinBudget(getHeapIndex(i), memoryRequirements.size))
+            {
+                continue;
+            }
+
+            const int score = countBits(propertyFlags & preferredFlags) - countBits(propertyFlags & unwantedFlags);
+            if (!typeFound || score > bestScore)
+            {
+                typeFound = true;
+                bestTypeIndex = i;
+                bestScore = score;
+            }
+        }
+
+        if (!typeFound)
+        {
+            throw std::runtime_error("Current device does not have any suitable memory types available within the heap budget");
+        }
+
+        return bestTypeIndex;
+    }
+
+    // Refreshes heap budgets, with VK_EXT_memory_budget the values come from the driver and include other processes
+    void updateBudget()
+    {
+        if (!memoryBudgetSupported)
+        {
+            for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+            {
+                heapBudgets.at(i) = memoryProperties.memoryHeaps[i].size / 10 * 8;
+                heapUsages.at(i) = 0;
+                budgetAllocatedHeapSizes.at(i) = 0;
+            }
+            return;
+        }
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            heapBudgets.at(i) = budgetProperties.heapBudget[i];
+            heapUsages.at(i) = budgetProperties.heapUsage[i];
+            budgetAllocatedHeapSizes.at(i) = statistics.getHeapCounter(i).getBlockBytes();
+        }
+    }
+
+    VkDeviceSize getHeapBudget(const uint32_t heapIndex) const
+    {
+        return heapBudgets.at(heapIndex);
+    }
+
+    // Usage reported at the last budget update plus everything this allocator allocated since then
+    VkDeviceSize getHeapUsage(const uint32_t heapIndex) const
+    {
+        return heapUsages.at(heapIndex) + statistics.getHeapCounter(heapIndex).getBlockBytes() - budgetAllocatedHeapSizes.at(heapIndex);
+    }
+
+    bool isWithinBudget(const uint32_t heapIndex, const VkDeviceSize size) const
+    {
+        return getHeapUsage(heapIndex) + size <= getHeapBudget(heapIndex);
+    }
+
+    uint32_t getHeapIndex(const uint32_t memoryTypeIndex) const
+    {
+        return memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    }
+
+    // Makes host writes to a persistently mapped allocation visible to the device, no-op for coherent memory
+    void flush(const VulkanMemoryAllocation& allocation, const VkDeviceSize offset, const VkDeviceSize size) const
+    {
+        if (isCoherent(allocation.getMemoryTypeIndex()))
+        {
+            return;
+        }
+
+        const VkDeviceSize rangeStart = (allocation.getOffset() + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+        const VkDeviceSize rangeEnd = std::min(FreeListAllocator::alignOffset(allocation.getOffset() + offset + size, nonCoherentAtomSize),
+            allocation.getOffset() + allocation.getSize());
+
+        const VkMappedMemoryRange memoryRange =
+        {
+            VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            nullptr,
+            allocation.getMemory(),
+            rangeStart,
+            rangeEnd - rangeStart
+        };
+
+        checkVulkanError(vkFlushMappedMemoryRanges(device, 1, &memoryRange), "vkFlushMappedMemoryRanges");
+    }
+
+    bool isHostVisible(const uint32_t memoryTypeIndex) const
+    {
+        return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    bool isCoherent(const uint32_t memoryTypeIndex) const
+    {
+        return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+
+    VkDeviceSize getBlockSize(const uint32_t memoryTypeIndex) const
+    {
+        const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        return std::min(preferredBlockSize, heapSize / 8);
+    }
+
+    VkPhysicalDevice getPhysicalDevice() const
+    {
+        return physicalDevice;
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    bool isMemoryBudgetSupported() const
+    {
+        return memoryBudgetSupported;
+    }
+
+    VkPhysicalDeviceMemoryProperties getMemoryProperties() const
+    {
+        return memoryProperties;
+    }
+
+    VkDeviceSize getPreferredBlockSize() const
+    {
+        return preferredBlockSize;
+    }
+
+    VkDeviceSize getNonCoherentAtomSize() const
+    {
+        return nonCoherentAtomSize;
+    }
+
+    const VulkanMemoryStatistics& getStatistics() const
+    {
+        return statistics;
+    }
+
+    // Fragmentation of a memory type is the share of its free space which lies outside of the largest free range of each block
+    void printStatisticsJson(std::ostream& output) const
+    {
+        output << "{" << std::endl << "  \"total\": {";
+        statistics.getTotalCounter().printJson(output);
+        output << "}," << std::endl << "  \"buffers\": {";
+        statistics.getResourceCounter(VulkanResourceType::Buffer).printJson(output);
+        output << "}," << std::endl << "  \"images\": {";
+        statistics.getResourceCounter(VulkanResourceType::Image).printJson(output);
+        output << "}," << std::endl << "  \"heaps\": [" << std::endl;
+
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            output << "    {\"index\": " << i << ", \"size\": " << memoryProperties.memoryHeaps[i].size << ", \"flags\": "
+                << memoryProperties.memoryHeaps[i].flags << ", \"budget\": " << getHeapBudget(i) << ", \"usage\": " << getHeapUsage(i) << ", ";
+            statistics.getHeapCounter(i).printJson(output);
+            output << "}" << (i + 1 < memoryProperties.memoryHeapCount ? "," : "") << std::endl;
+        }
+
+        output << "  ]," << std::endl << "  \"memoryTypes\": [" << std::endl;
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            VkDeviceSize freeBytes = 0;
+            VkDeviceSize largestFreeRange = 0;
+            VkDeviceSize contiguousFreeBytes = 0;
+
+            for (const auto* blocks : {&bufferBlocks.at(i), &imageBlocks.at(i)})
+            {
+                for (const auto& block : *blocks)
+                {
+                    freeBytes += block->getRanges().getFreeSize();
+                    largestFreeRange = std::max<VkDeviceSize>(largestFreeRange, block->getRanges().getLargestFreeRange());
+                    contiguousFreeBytes += block->getRanges().getLargestFreeRange();
+                }
+            }
+
+            const double fragmentation = freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(contiguousFreeBytes) / static_cast<double>(freeBytes);
+
+            output << "    {\"index\": " << i << ", \"heapIndex\": " << getHeapIndex(i) << ", \"propertyFlags\": "
+                << memoryProperties.memoryTypes[i].propertyFlags << ", ";
+            statistics.getTypeCounter(i).printJson(output);
+            output << ", \"freeBytes\": " << freeBytes << ", \"largestFreeRange\": " << largestFreeRange << ", \"fragmentation\": "
+                << fragmentation << "}" << (i + 1 < memoryProperties.memoryTypeCount ? "," : "") << std::endl;
+        }
+
+        output << "  ]" << std::endl << "}" << std::endl;
+    }
+
+private:
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    bool memoryBudgetSupported;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize preferredBlockSize;
+    VkDeviceSize nonCoherentAtomSize;
+    VulkanMemoryStatistics statistics;
+    std::vector<std::vector<std::unique_ptr<VulkanMemoryBlock>>> bufferBlocks;
+    std::vector<std::vector<std::unique_ptr<VulkanMemoryBlock>>> imageBlocks;
+    std::vector<VkDeviceSize> heapBudgets;
+    std::vector<VkDeviceSize> heapUsages;
+    std::vector<VkDeviceSize> budgetAllocatedHeapSizes;
+
+    static VkDeviceSize getUsedSize(const VulkanMemoryBlock& block)
+    {
+        return block.getRanges().getSize() - block.getRanges().getFreeSize();
+    }
+
+    static VkPhysicalDeviceMemoryProperties queryMemoryProperties(VkPhysicalDevice physicalDevice)
+    {
+        VkPhysicalDeviceMemoryProperties properties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+        return properties;
+    }
+
+    static void getMemoryUsageFlags(const VulkanMemoryUsage usage, VkMemoryPropertyFlags& requiredFlags, VkMemoryPropertyFlags& preferredFlags,
+        VkMemoryPropertyFlags& unwantedFlags)
+    {
+        switch (usage)
+        {
+        case VulkanMemoryUsage::GpuOnly:
+            // Host visible device local memory is a scarce window into video memory, leave it for dynamic data
+            requiredFlags = 0;
+            preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            unwantedFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+        case VulkanMemoryUsage::CpuToGpu:
+            requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            unwantedFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        case VulkanMemoryUsage::GpuToCpu:
+            requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            unwantedFlags = 0;
+            break;
+        case VulkanMemoryUsage::Dynamic:
+            requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            unwantedFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        default:
+            throw std::runtime_error("Unknown memory usage");
+        }
+    }
+
+    static int countBits(VkMemoryPropertyFlags flags)
+    {
+        int count = 0;
+
+        while (flags != 0)
+        {
+            count += flags & 1;
+            flags >>= 1;
+        }
+
+        return count;
+    }
+
+    std::vector<std::unique_ptr<VulkanMemoryBlock>>& getBlocks(const uint32_t memoryTypeIndex, const VulkanResourceType resourceType)
+    {
+        if (resourceType == VulkanResourceType::Image)
+        {
+            return imageBlocks.at(memoryTypeIndex);
+        }
+
+        return bufferBlocks.at(memoryTypeIndex);
+    }
+
+    // Requested memory type is kept while its heap has room for the allocation, otherwise a compatible type with at least the same
+    // properties in a heap within budget takes it. Budgets have to be refreshed beforehand.
+    uint32_t findMemoryTypeIndexWithinBudget(const uint32_t typeFilter, const uint32_t memoryTypeIndex, const VkDeviceSize size) const
+    {
+        if (isWithinBudget(getHeapIndex(memoryTypeIndex), size))
+        {
+            return memoryTypeIndex;
+        }
+
+        const VkMemoryPropertyFlags properties = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties
+                && isWithinBudget(getHeapIndex(i), size))
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Allocation would exceed the budget of every compatible memory heap");
+    }
+
+    VulkanMemoryAllocation allocateDedicated(const VkDeviceSize size, const uint32_t memoryTypeIndex, const VulkanResourceType resourceType,
+        VkImage dedicatedImage)
+    {
+        const VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            nullptr,
+            dedicatedImage,
+            VK_NULL_HANDLE
+        };
+
+        const VkMemoryAllocateInfo memoryAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            dedicatedImage != VK_NULL_HANDLE ? &dedicatedAllocateInfo : nullptr,
+            size,
+            memoryTypeIndex
+        };
+
+        VkDeviceMemory memory;
+        checkVulkanError(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory), "vkAllocateMemory");
+
+        void* mappedData = nullptr;
+        if (isHostVisible(memoryTypeIndex))
+        {
+            VulkanMemoryBlock::mapMemory(device, memory, mappedData);
+        }
+
+        statistics.recordBlockAllocation(memoryTypeIndex, resourceType, size);
+        statistics.recordAllocation(memoryTypeIndex, resourceType, size);
+
+        return VulkanMemoryAllocation(memory, 0, size, memoryTypeIndex, resourceType, true, mappedData);
+    }
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_memory_allocation.h"
+
+namespace VulkanLearning
+{
+
+// Block counters track device memory objects, allocation counters track the resources sub-allocated from them
+class VulkanMemoryCounter
+{
+public:
+    VulkanMemoryCounter() :
+        allocationCount(0),
+        allocatedBytes(0),
+        peakAllocatedBytes(0),
+        blockCount(0),
+        blockBytes(0),
+        peakBlockBytes(0)
+    {}
+
+    void addAllocation(const VkDeviceSize size)
+    {
+        allocationCount++;
+        allocatedBytes += size;
+        peakAllocatedBytes = std::max(peakAllocatedBytes, allocatedBytes);
+    }
+
+    void removeAllocation(const VkDeviceSize size)
+    {
+        allocationCount--;
+        allocatedBytes -= size;
+    }
+
+    void addBlock(const VkDeviceSize size)
+    {
+        blockCount++;
+        blockBytes += size;
+        peakBlockBytes = std::max(peakBlockBytes, blockBytes);
+    }
+
+    void removeBlock(const VkDeviceSize size)
+    {
+        blockCount--;
+        blockBytes -= size;
+    }
+
+    void printJson(std::ostream& output) const
+    {
+        output << "\"allocationCount\": " << allocationCount << ", \"allocatedBytes\": " << allocatedBytes << ", \"peakAllocatedBytes\": "
+            << peakAllocatedBytes << ", \"blockCount\": " << blockCount << ", \"blockBytes\": " << blockBytes << ", \"peakBlockBytes\": "
+            << peakBlockBytes;
+    }
+
+    uint64_t getAllocationCount() const
+    {
+        return allocationCount;
+    }
+
+    VkDeviceSize getAllocatedBytes() const
+    {
+        return allocatedBytes;
+    }
+
+    VkDeviceSize getPeakAllocatedBytes() const
+    {
+        return peakAllocatedBytes;
+    }
+
+    uint64_t getBlockCount() const
+    {
+        return blockCount;
+    }
+
+    VkDeviceSize getBlockBytes() const
+    {
+        return blockBytes;
+    }
+
+    VkDeviceSize getPeakBlockBytes() const
+    {
+        return peakBlockBytes;
+    }
+
+private:
+    uint64_t allocationCount;
+    VkDeviceSize allocatedBytes;
+    VkDeviceSize peakAllocatedBytes;
+    uint64_t blockCount;
+    VkDeviceSize blockBytes;
+    VkDeviceSize peakBlockBytes;
+};
+
+// Registry of all device memory held by an allocator, broken down per heap, per memory type and per resource kind
+class VulkanMemoryStatistics
+{
+public:
+    explicit VulkanMemoryStatistics(const VkPhysicalDeviceMemoryProperties& memoryProperties) :
+        memoryProperties(memoryProperties),
+        heapCounters(memoryProperties.memoryHeapCount),
+        typeCounters(memoryProperties.memoryTypeCount)
+    {}
+
+    void recordAllocation(const uint32_t memoryTypeIndex, const VulkanResourceType resourceType, const VkDeviceSize size)
+    {
+        totalCounter.addAllocation(size);
+        getResourceCounter(resourceType).addAllocation(size);
+        typeCounters.at(memoryTypeIndex).addAllocation(size);
+        heapCounters.at(memoryProperties.memoryTypes[memoryTypeIndex].heapIndex).addAllocation(size);
+    }
+
+    void recordFree(const uint32_t memoryTypeIndex, const VulkanResourceType resourceType, const VkDeviceSize size)
+    {
+        totalCounter.removeAllocation(size);
+        getResourceCounter(resourceType).removeAllocation(size);
+        typeCounters.at(memoryTypeIndex).removeAllocation(size);
+        heapCounters.at(memoryProperties.memoryTypes[memoryTypeIndex].heapIndex).removeAllocation(size);
+    }
+
+    void recordBlockAllocation(const uint32_t memoryTypeIndex, const VulkanResourceType resourceType, const VkDeviceSize size)
+    {
+        totalCounter.addBlock(size);
+        getResourceCounter(resourceType).addBlock(size);
+        typeCounters.at(memoryTypeIndex).addBlock(size);
+        heapCounters.at(memoryProperties.memoryTypes[memoryTypeIndex].heapIndex).addBlock(size);
+    }
+
+    void recordBlockFree(const uint32_t memoryTypeIndex, const VulkanResourceType resourceType, const VkDeviceSize size)
+    {
+        totalCounter.removeBlock(size);
+        getResourceCounter(resourceType).removeBlock(size);
+        typeCounters.at(memoryTypeIndex).removeBlock(size);
+        heapCounters.at(memoryProperties.memoryTypes[memoryTypeIndex].heapIndex).removeBlock(size);
+    }
+
+    const VulkanMemoryCounter& getTotalCounter() const
+    {
+        return totalCounter;
+    }
+
+    const VulkanMemoryCounter& getResourceCounter(const VulkanResourceType resourceType) const
+    {
+        if (resourceType == VulkanResourceType::Image)
+        {
+            return imageCounter;
+        }
+
+        return bufferCounter;
+    }
+
+    const VulkanMemoryCounter& getHeapCounter(const uint32_t heapIndex) const
+    {
+        return heapCounters.at(heapIndex);
+    }
+
+    const VulkanMemoryCounter& getTypeCounter(const uint32_t memoryTypeIndex) const
+    {
+        return typeCounters.at(memoryTypeIndex);
+    }
+
+private:
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VulkanMemoryCounter totalCounter;
+    VulkanMemoryCounter bufferCounter;
+    VulkanMemoryCounter imageCounter;
+    std::vector<VulkanMemoryCounter> heapCounters;
+    std::vector<VulkanMemoryCounter> typeCounters;
+
+    VulkanMemoryCounter& getResourceCounter(const VulkanResourceType resourceType)
+    {
+        if (resourceType == VulkanResourceType::Image)
+        {
+            return imageCounter;
+        }
+
+        return bufferCounter;
+    }
+};
+
+} // namespace VulkanLearning
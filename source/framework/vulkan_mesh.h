@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include "vulkan/vulkan.h"
+
+namespace VulkanLearning
+{
+
+// Location of a mesh inside the shared vertex and index buffers of a geometry pool
+class VulkanMesh
+{
+public:
+    VulkanMesh() :
+        VulkanMesh(0, 0, 0, 0)
+    {}
+
+    explicit VulkanMesh(const uint32_t vertexOffset, const uint32_t vertexCount, const uint32_t firstIndex, const uint32_t indexCount) :
+        vertexOffset(vertexOffset),
+        vertexCount(vertexCount),
+        firstIndex(firstIndex),
+        indexCount(indexCount)
+    {}
+
+    VkDrawIndexedIndirectCommand getDrawCommand() const
+    {
+        return VkDrawIndexedIndirectCommand
+        {
+            indexCount,
+            1,
+            firstIndex,
+            static_cast<int32_t>(vertexOffset),
+            0
+        };
+    }
+
+    uint32_t getVertexOffset() const
+    {
+        return vertexOffset;
+    }
+
+    uint32_t getVertexCount() const
+    {
+        return vertexCount;
+    }
+
+    uint32_t getFirstIndex() const
+    {
+        return firstIndex;
+    }
+
+    uint32_t getIndexCount() const
+    {
+        return indexCount;
+    }
+
+private:
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+} // namespace VulkanLearning
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include "vulkan/vulkan.h"
+#include "vulkan_pipeline_description.h"
+#include "vulkan_pipeline_state_cache.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -13,49 +15,45 @@ namespace VulkanLearning
 class VulkanPipeline
 {
 public:
-    explicit VulkanPipeline(VkDevice device, VkRenderPass renderPass, VkShaderModule vertexShader, VkShaderModule fragmentShader,
-        const VkExtent2D& swapChainExtent) :
+    explicit VulkanPipeline(VkDevice device, VkRenderPass renderPass, VkShaderModule vertexShader, VkShaderModule fragmentShader) :
         device(device),
-        vertexShader(vertexShader),
-        fragmentShader(fragmentShader)
+        description(vertexShader, fragmentShader, VK_FORMAT_UNDEFINED),
+        stateCache(nullptr),
+        pipelineCache(VK_NULL_HANDLE)
     {
-        const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr
-        };
-
-        this->vertexInputStateCreateInfo = vertexInputStateCreateInfo;
-        initializePipeline(renderPass, swapChainExtent, descriptorSetLayouts);
+        initializePipeline(renderPass);
     }
 
     explicit VulkanPipeline(VkDevice device, VkRenderPass renderPass, VkShaderModule vertexShader, VkShaderModule fragmentShader,
-        const VkExtent2D& swapChainExtent, const VkVertexInputBindingDescription& vertexInputBindingDescription,
+        const VkVertexInputBindingDescription& vertexInputBindingDescription,
         const std::array<VkVertexInputAttributeDescription, 2>& vertexInputAttributeDescriptions,
         const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts) :
+        VulkanPipeline(device, renderPass, vertexShader, fragmentShader, vertexInputBindingDescription, vertexInputAttributeDescriptions,
+            descriptorSetLayouts, VK_NULL_HANDLE)
+    {}
+
+    // Pipelines created through a pipeline cache, including reloads, reuse compiled shaders stored in the cache
+    explicit VulkanPipeline(VkDevice device, VkRenderPass renderPass, VkShaderModule vertexShader, VkShaderModule fragmentShader,
+        const VkVertexInputBindingDescription& vertexInputBindingDescription,
+        const std::array<VkVertexInputAttributeDescription, 2>& vertexInputAttributeDescriptions,
+        const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, VkPipelineCache pipelineCache) :
         device(device),
-        vertexShader(vertexShader),
-        fragmentShader(fragmentShader),
-        descriptorSetLayouts(descriptorSetLayouts)
+        description(createDescription(vertexShader, fragmentShader, vertexInputBindingDescription, vertexInputAttributeDescriptions,
+            descriptorSetLayouts)),
+        stateCache(nullptr),
+        pipelineCache(pipelineCache)
     {
-        const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            1,
-            &vertexInputBindingDescription,
-            static_cast<uint32_t>(vertexInputAttributeDescriptions.size()),
-            vertexInputAttributeDescriptions.data()
-        };
+        initializePipeline(renderPass);
+    }
 
-        this->vertexInputStateCreateInfo = vertexInputStateCreateInfo;
-        initializePipeline(renderPass, swapChainExtent, descriptorSetLayouts);
+    // Pipeline and its layout are owned by the state cache and shared with all pipelines of an equal description
+    explicit VulkanPipeline(VulkanPipelineStateCache& stateCache, VkRenderPass renderPass, const VulkanPipelineDescription& description) :
+        device(stateCache.getDevice()),
+        description(description),
+        stateCache(&stateCache),
+        pipelineCache(stateCache.getPipelineCache())
+    {
+        initializePipeline(renderPass);
     }
 
     ~VulkanPipeline()
@@ -65,13 +63,27 @@ public:
 
     void destroyPipeline()
     {
-        vkDestroyPipeline(device, pipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        if (stateCache == nullptr)
+        {
+            vkDestroyPipeline(device, pipeline, nullptr);
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        }
+
+        pipeline = VK_NULL_HANDLE;
+        pipelineLayout = VK_NULL_HANDLE;
+    }
+
+    // Viewport and scissor are dynamic, so the pipeline only has to be reloaded when the render pass changes
+    void reloadPipeline(VkRenderPass renderPass)
+    {
+        initializePipeline(renderPass);
     }
 
-    void reloadPipeline(VkRenderPass renderPass, const VkExtent2D& swapChainExtent)
+    // Render pass with a different color format is not compatible with the previous pipeline
+    void reloadPipeline(VkRenderPass renderPass, const VkFormat colorFormat)
     {
-        initializePipeline(renderPass, swapChainExtent, descriptorSetLayouts);
+        description.setColorFormat(colorFormat);
+        initializePipeline(renderPass);
     }
 
     VkDevice getDevice() const
@@ -81,12 +93,17 @@ public:
 
     VkShaderModule getVertexShader() const
     {
-        return vertexShader;
+        return description.getVertexShader();
     }
 
     VkShaderModule getFragmentShader() const
     {
-        return vertexShader;
+        return description.getFragmentShader();
+    }
+
+    const VulkanPipelineDescription& getDescription() const
+    {
+        return description;
     }
 
     VkPipelineLayout getPipelineLayout() const
@@ -99,170 +116,43 @@ public:
         return pipeline;
     }
 
+    VkPipelineCache getPipelineCache() const
+    {
+        return pipelineCache;
+    }
+
 private:
     VkDevice device;
-    VkShaderModule vertexShader;
-    VkShaderModule fragmentShader;
+    VulkanPipelineDescription description;
+    VulkanPipelineStateCache* stateCache;
+    VkPipelineCache pipelineCache;
     VkPipelineLayout pipelineLayout;
     VkPipeline pipeline;
-    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
 
-    void initializePipeline(VkRenderPass renderPass, const VkExtent2D& swapChainExtent,
-        const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+    void initializePipeline(VkRenderPass renderPass)
     {
-        const VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_SHADER_STAGE_VERTEX_BIT,
-            vertexShader,
-            "main",
-            nullptr
-        };
-
-        const VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_SHADER_STAGE_FRAGMENT_BIT,
-            fragmentShader,
-            "main",
-            nullptr
-        };
-
-        std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfos{ vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo };
-
-        const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            VK_FALSE
-        };
-
-        const VkViewport viewport =
-        {
-            0.0f,
-            0.0f,
-            static_cast<float>(swapChainExtent.width),
-            static_cast<float>(swapChainExtent.height),
-            0.0f,
-            1.0f
-        };
-
-        const VkRect2D scissor =
-        {
-            VkOffset2D{0, 0},
-            swapChainExtent
-        };
-
-        const VkPipelineViewportStateCreateInfo viewportStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            1,
-            &viewport,
-            1,
-            &scissor
-        };
-
-        const VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_FALSE,
-            VK_FALSE,
-            VK_POLYGON_MODE_FILL,
-            VK_CULL_MODE_BACK_BIT,
-            VK_FRONT_FACE_COUNTER_CLOCKWISE,
-            VK_FALSE,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f
-        };
-
-        const VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo =
+        if (stateCache != nullptr)
         {
-            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_SAMPLE_COUNT_1_BIT,
-            VK_FALSE,
-            1.0f,
-            nullptr,
-            VK_FALSE,
-            VK_FALSE
-        };
+            pipelineLayout = stateCache->getPipelineLayout(description.getLayout());
+            pipeline = stateCache->getPipeline(description, renderPass);
+            return;
+        }
 
-        const VkPipelineColorBlendAttachmentState colorBlendAttachmentState =
-        {
-            VK_FALSE,
-            VK_BLEND_FACTOR_ONE,
-            VK_BLEND_FACTOR_ZERO,
-            VK_BLEND_OP_ADD,
-            VK_BLEND_FACTOR_ONE,
-            VK_BLEND_FACTOR_ZERO,
-            VK_BLEND_OP_ADD,
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
-        };
-
-        const VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            nullptr,
-            0,
-            VK_FALSE,
-            VK_LOGIC_OP_COPY,
-            1,
-            &colorBlendAttachmentState,
-            {0.0f, 0.0f, 0.0f, 0.0f}
-        };
-
-        const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
-        {
-            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            nullptr,
-            0,
-            static_cast<uint32_t>(descriptorSetLayouts.size()),
-            descriptorSetLayouts.data(),
-            0,
-            0
-        };
-
-        checkVulkanError(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout), "vkCreatePipelineLayout");
-
-        const VkGraphicsPipelineCreateInfo graphicsPipelineInfo =
-        {
-            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            nullptr,
-            0,
-            2,
-            shaderStageCreateInfos.data(),
-            &vertexInputStateCreateInfo,
-            &inputAssemblyStateCreateInfo,
-            nullptr,
-            &viewportStateCreateInfo,
-            &rasterizationStateCreateInfo,
-            &multisampleStateCreateInfo,
-            nullptr,
-            &colorBlendStateCreateInfo,
-            nullptr,
-            pipelineLayout,
-            renderPass,
-            0,
-            VK_NULL_HANDLE,
-            -1
-        };
+        pipelineLayout = description.getLayout().createPipelineLayout(device);
+        pipeline = description.createPipeline(device, pipelineCache, renderPass, pipelineLayout);
+    }
 
-        checkVulkanError(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicsPipelineInfo, nullptr, &pipeline),
-            "vkCreateGraphicsPipelines");
+    // Color format is only part of the key in the state cache, pipelines which are not shared can leave it undefined
+    static VulkanPipelineDescription createDescription(VkShaderModule vertexShader, VkShaderModule fragmentShader,
+        const VkVertexInputBindingDescription& vertexInputBindingDescription,
+        const std::array<VkVertexInputAttributeDescription, 2>& vertexInputAttributeDescriptions,
+        const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+    {
+        VulkanPipelineDescription description(vertexShader, fragmentShader, VK_FORMAT_UNDEFINED);
+        description.setVertexInput({vertexInputBindingDescription},
+            std::vector<VkVertexInputAttributeDescription>(vertexInputAttributeDescriptions.begin(), vertexInputAttributeDescriptions.end()));
+        description.setLayout(VulkanPipelineLayoutDescription(descriptorSetLayouts));
+        return description;
     }
 };
 
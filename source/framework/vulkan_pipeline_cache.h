@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Pipeline cache shared by all pipelines of a device and persisted between runs. Cache data is only reused if its header
+// matches the device and driver it was created with, otherwise the cache starts empty and is rebuilt during the run.
+class VulkanPipelineCache
+{
+public:
+    explicit VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filePath) :
+        device(device),
+        properties(properties),
+        filePath(filePath),
+        loadedDataSize(0)
+    {
+        std::vector<char> data = loadFile(filePath);
+
+        if (!isCompatible(data))
+        {
+            data.clear();
+        }
+
+        loadedDataSize = data.size();
+
+        const VkPipelineCacheCreateInfo pipelineCacheCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            nullptr,
+            0,
+            data.size(),
+            data.empty() ? nullptr : data.data()
+        };
+
+        checkVulkanError(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache), "vkCreatePipelineCache");
+    }
+
+    ~VulkanPipelineCache()
+    {
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    }
+
+    // Data is written into a temporary file first and then moved over the previous cache, so an interrupted save never leaves
+    // a truncated cache behind
+    void save() const
+    {
+        size_t dataSize = 0;
+        checkVulkanError(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), "vkGetPipelineCacheData");
+
+        std::vector<char> data(dataSize);
+        checkVulkanError(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()), "vkGetPipelineCacheData");
+        data.resize(dataSize);
+
+        const std::string temporaryPath = filePath + ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+            if (!file.is_open())
+            {
+                throw std::runtime_error(std::string("Unable to open file: ") + temporaryPath);
+            }
+
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            file.flush();
+
+            if (!file.good())
+            {
+                throw std::runtime_error(std::string("Unable to write file: ") + temporaryPath);
+            }
+        }
+
+        // Rename does not replace existing files on Windows
+        if (std::rename(temporaryPath.c_str(), filePath.c_str()) != 0)
+        {
+            std::remove(filePath.c_str());
+
+            if (std::rename(temporaryPath.c_str(), filePath.c_str()) != 0)
+            {
+                std::remove(temporaryPath.c_str());
+                throw std::runtime_error(std::string("Unable to replace file: ") + filePath);
+            }
+        }
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkPipelineCache getPipelineCache() const
+    {
+        return pipelineCache;
+    }
+
+    const std::string& getFilePath() const
+    {
+        return filePath;
+    }
+
+    // Zero if there was no compatible cache file, in which case all pipelines are compiled from scratch
+    size_t getLoadedDataSize() const
+    {
+        return loadedDataSize;
+    }
+
+    bool isWarm() const
+    {
+        return loadedDataSize > 0;
+    }
+
+private:
+    VkDevice device;
+    VkPhysicalDeviceProperties properties;
+    std::string filePath;
+    size_t loadedDataSize;
+    VkPipelineCache pipelineCache;
+
+    // Missing file is not an error, the cache is simply created empty
+    static std::vector<char> loadFile(const std::string& filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+
+        if (!file.is_open())
+        {
+            return std::vector<char>{};
+        }
+
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    bool isCompatible(const std::vector<char>& data) const
+    {
+        VkPipelineCacheHeaderVersionOne header;
+
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header) && header.headerSize <= data.size()
+            && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && header.vendorID == properties.vendorID
+            && header.deviceID == properties.deviceID
+            && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+};
+
+} // namespace VulkanLearning
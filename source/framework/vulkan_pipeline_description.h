@@ -0,0 +1,507 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_specialization_constants.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Combines hash of the value into the seed
+template <typename T>
+void hashCombine(size_t& seed, const T& value)
+{
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// Descriptor set layouts and push constant ranges, pipelines with equal layout descriptions can share a pipeline layout
+class VulkanPipelineLayoutDescription
+{
+public:
+    VulkanPipelineLayoutDescription()
+    {}
+
+    explicit VulkanPipelineLayoutDescription(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts) :
+        descriptorSetLayouts(descriptorSetLayouts)
+    {}
+
+    void addPushConstantRange(const VkShaderStageFlags stageFlags, const uint32_t offset, const uint32_t size)
+    {
+        pushConstantRanges.push_back(VkPushConstantRange{stageFlags, offset, size});
+    }
+
+    void addPushConstantRange(const VkPushConstantRange& range)
+    {
+        pushConstantRanges.push_back(range);
+    }
+
+    VkPipelineLayout createPipelineLayout(VkDevice device) const
+    {
+        const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            nullptr,
+            0,
+            static_cast<uint32_t>(descriptorSetLayouts.size()),
+            descriptorSetLayouts.data(),
+            static_cast<uint32_t>(pushConstantRanges.size()),
+            pushConstantRanges.data()
+        };
+
+        VkPipelineLayout pipelineLayout;
+        checkVulkanError(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout), "vkCreatePipelineLayout");
+        return pipelineLayout;
+    }
+
+    size_t getHash() const
+    {
+        size_t seed = 0;
+
+        for (const auto layout : descriptorSetLayouts)
+        {
+            hashCombine(seed, layout);
+        }
+
+        for (const auto& range : pushConstantRanges)
+        {
+            hashCombine(seed, range.stageFlags);
+            hashCombine(seed, range.offset);
+            hashCombine(seed, range.size);
+        }
+
+        return seed;
+    }
+
+    bool operator==(const VulkanPipelineLayoutDescription& other) const
+    {
+        if (descriptorSetLayouts != other.descriptorSetLayouts || pushConstantRanges.size() != other.pushConstantRanges.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < pushConstantRanges.size(); ++i)
+        {
+            const VkPushConstantRange& range = pushConstantRanges[i];
+            const VkPushConstantRange& otherRange = other.pushConstantRanges[i];
+
+            if (range.stageFlags != otherRange.stageFlags || range.offset != otherRange.offset || range.size != otherRange.size)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const VulkanPipelineLayoutDescription& other) const
+    {
+        return !(*this == other);
+    }
+
+    const std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts() const
+    {
+        return descriptorSetLayouts;
+    }
+
+    const std::vector<VkPushConstantRange>& getPushConstantRanges() const
+    {
+        return pushConstantRanges;
+    }
+
+private:
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+// Complete state of a graphics pipeline with a single color attachment. Render passes in this framework are compatible whenever
+// their color formats match, so the format stands for the render pass in the key and the pipeline may be used with any
+// render pass of that format.
+class VulkanPipelineDescription
+{
+public:
+    explicit VulkanPipelineDescription(VkShaderModule vertexShader, VkShaderModule fragmentShader, const VkFormat colorFormat) :
+        vertexShader(vertexShader),
+        fragmentShader(fragmentShader),
+        colorFormat(colorFormat),
+        topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
+        polygonMode(VK_POLYGON_MODE_FILL),
+        cullMode(VK_CULL_MODE_BACK_BIT),
+        frontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE),
+        colorBlendAttachmentState
+        {
+            VK_FALSE,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+        }
+    {}
+
+    void setVertexInput(const std::vector<VkVertexInputBindingDescription>& bindings,
+        const std::vector<VkVertexInputAttributeDescription>& attributes)
+    {
+        vertexInputBindingDescriptions = bindings;
+        vertexInputAttributeDescriptions = attributes;
+    }
+
+    void setLayout(const VulkanPipelineLayoutDescription& layout)
+    {
+        this->layout = layout;
+    }
+
+    void setColorFormat(const VkFormat colorFormat)
+    {
+        this->colorFormat = colorFormat;
+    }
+
+    void setTopology(const VkPrimitiveTopology topology)
+    {
+        this->topology = topology;
+    }
+
+    void setRasterizationState(const VkPolygonMode polygonMode, const VkCullModeFlags cullMode, const VkFrontFace frontFace)
+    {
+        this->polygonMode = polygonMode;
+        this->cullMode = cullMode;
+        this->frontFace = frontFace;
+    }
+
+    void setColorBlendAttachmentState(const VkPipelineColorBlendAttachmentState& state)
+    {
+        colorBlendAttachmentState = state;
+    }
+
+    // Each set of constants produces a separate pipeline variant compiled from the same shader module
+    void setSpecializationConstants(const VkShaderStageFlagBits stage, const VulkanSpecializationConstants& constants)
+    {
+        if (stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            vertexSpecializationConstants = constants;
+        }
+        else if (stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+        {
+            fragmentSpecializationConstants = constants;
+        }
+        else
+        {
+            throw std::runtime_error("Specialization constants are only supported for vertex and fragment shader stages");
+        }
+    }
+
+    // Render pass has to use the color format of the description, viewport and scissor are dynamic state
+    VkPipeline createPipeline(VkDevice device, VkPipelineCache pipelineCache, VkRenderPass renderPass, VkPipelineLayout pipelineLayout) const
+    {
+        const VkSpecializationInfo vertexSpecializationInfo = vertexSpecializationConstants.getSpecializationInfo();
+        const VkSpecializationInfo fragmentSpecializationInfo = fragmentSpecializationConstants.getSpecializationInfo();
+
+        const VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            nullptr,
+            0,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            vertexShader,
+            "main",
+            vertexSpecializationConstants.isEmpty() ? nullptr : &vertexSpecializationInfo
+        };
+
+        const VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            nullptr,
+            0,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            fragmentShader,
+            "main",
+            fragmentSpecializationConstants.isEmpty() ? nullptr : &fragmentSpecializationInfo
+        };
+
+        std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfos{ vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo };
+
+        const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            static_cast<uint32_t>(vertexInputBindingDescriptions.size()),
+            vertexInputBindingDescriptions.data(),
+            static_cast<uint32_t>(vertexInputAttributeDescriptions.size()),
+            vertexInputAttributeDescriptions.data()
+        };
+
+        const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            topology,
+            VK_FALSE
+        };
+
+        // Viewport and scissor are set when command buffers are recorded
+        const VkPipelineViewportStateCreateInfo viewportStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            1,
+            nullptr,
+            1,
+            nullptr
+        };
+
+        const std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+        const VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            static_cast<uint32_t>(dynamicStates.size()),
+            dynamicStates.data()
+        };
+
+        const VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            VK_FALSE,
+            VK_FALSE,
+            polygonMode,
+            cullMode,
+            frontFace,
+            VK_FALSE,
+            0.0f,
+            0.0f,
+            0.0f,
+            1.0f
+        };
+
+        const VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_FALSE,
+            1.0f,
+            nullptr,
+            VK_FALSE,
+            VK_FALSE
+        };
+
+        const VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            nullptr,
+            0,
+            VK_FALSE,
+            VK_LOGIC_OP_COPY,
+            1,
+            &colorBlendAttachmentState,
+            {0.0f, 0.0f, 0.0f, 0.0f}
+        };
+
+        const VkGraphicsPipelineCreateInfo graphicsPipelineInfo =
+        {
+            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            nullptr,
+            0,
+            static_cast<uint32_t>(shaderStageCreateInfos.size()),
+            shaderStageCreateInfos.data(),
+            &vertexInputStateCreateInfo,
+            &inputAssemblyStateCreateInfo,
+            nullptr,
+            &viewportStateCreateInfo,
+            &rasterizationStateCreateInfo,
+            &multisampleStateCreateInfo,
+            nullptr,
+            &colorBlendStateCreateInfo,
+            &dynamicStateCreateInfo,
+            pipelineLayout,
+            renderPass,
+            0,
+            VK_NULL_HANDLE,
+            -1
+        };
+
+        VkPipeline pipeline;
+        checkVulkanError(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineInfo, nullptr, &pipeline),
+            "vkCreateGraphicsPipelines");
+        return pipeline;
+    }
+
+    size_t getHash() const
+    {
+        size_t seed = layout.getHash();
+        hashCombine(seed, vertexShader);
+        hashCombine(seed, fragmentShader);
+        hashCombine(seed, static_cast<int32_t>(colorFormat));
+        hashCombine(seed, static_cast<int32_t>(topology));
+        hashCombine(seed, static_cast<int32_t>(polygonMode));
+        hashCombine(seed, cullMode);
+        hashCombine(seed, static_cast<int32_t>(frontFace));
+
+        for (const auto& binding : vertexInputBindingDescriptions)
+        {
+            hashCombine(seed, binding.binding);
+            hashCombine(seed, binding.stride);
+            hashCombine(seed, static_cast<int32_t>(binding.inputRate));
+        }
+
+        for (const auto& attribute : vertexInputAttributeDescriptions)
+        {
+            hashCombine(seed, attribute.location);
+            hashCombine(seed, attribute.binding);
+            hashCombine(seed, static_cast<int32_t>(attribute.format));
+            hashCombine(seed, attribute.offset);
+        }
+
+        hashCombine(seed, colorBlendAttachmentState.blendEnable);
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.srcColorBlendFactor));
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.dstColorBlendFactor));
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.colorBlendOp));
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.srcAlphaBlendFactor));
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.dstAlphaBlendFactor));
+        hashCombine(seed, static_cast<int32_t>(colorBlendAttachmentState.alphaBlendOp));
+        hashCombine(seed, colorBlendAttachmentState.colorWriteMask);
+        hashSpecializationConstants(seed, vertexSpecializationConstants);
+        hashSpecializationConstants(seed, fragmentSpecializationConstants);
+        return seed;
+    }
+
+    bool operator==(const VulkanPipelineDescription& other) const
+    {
+        if (vertexShader != other.vertexShader || fragmentShader != other.fragmentShader || colorFormat != other.colorFormat
+            || topology != other.topology || polygonMode != other.polygonMode || cullMode != other.cullMode || frontFace != other.frontFace
+            || layout != other.layout || !isBlendStateEqual(colorBlendAttachmentState, other.colorBlendAttachmentState)
+            || vertexSpecializationConstants != other.vertexSpecializationConstants
+            || fragmentSpecializationConstants != other.fragmentSpecializationConstants
+            || vertexInputBindingDescriptions.size() != other.vertexInputBindingDescriptions.size()
+            || vertexInputAttributeDescriptions.size() != other.vertexInputAttributeDescriptions.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < vertexInputBindingDescriptions.size(); ++i)
+        {
+            const VkVertexInputBindingDescription& binding = vertexInputBindingDescriptions[i];
+            const VkVertexInputBindingDescription& otherBinding = other.vertexInputBindingDescriptions[i];
+
+            if (binding.binding != otherBinding.binding || binding.stride != otherBinding.stride || binding.inputRate != otherBinding.inputRate)
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < vertexInputAttributeDescriptions.size(); ++i)
+        {
+            const VkVertexInputAttributeDescription& attribute = vertexInputAttributeDescriptions[i];
+            const VkVertexInputAttributeDescription& otherAttribute = other.vertexInputAttributeDescriptions[i];
+
+            if (attribute.location != otherAttribute.location || attribute.binding != otherAttribute.binding
+                || attribute.format != otherAttribute.format || attribute.offset != otherAttribute.offset)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const VulkanPipelineDescription& other) const
+    {
+        return !(*this == other);
+    }
+
+    VkShaderModule getVertexShader() const
+    {
+        return vertexShader;
+    }
+
+    VkShaderModule getFragmentShader() const
+    {
+        return fragmentShader;
+    }
+
+    VkFormat getColorFormat() const
+    {
+        return colorFormat;
+    }
+
+    const VulkanPipelineLayoutDescription& getLayout() const
+    {
+        return layout;
+    }
+
+    const VulkanSpecializationConstants& getVertexSpecializationConstants() const
+    {
+        return vertexSpecializationConstants;
+    }
+
+    const VulkanSpecializationConstants& getFragmentSpecializationConstants() const
+    {
+        return fragmentSpecializationConstants;
+    }
+
+private:
+    VkShaderModule vertexShader;
+    VkShaderModule fragmentShader;
+    VkFormat colorFormat;
+    std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+    VulkanPipelineLayoutDescription layout;
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygonMode;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState;
+    VulkanSpecializationConstants vertexSpecializationConstants;
+    VulkanSpecializationConstants fragmentSpecializationConstants;
+
+    static bool isBlendStateEqual(const VkPipelineColorBlendAttachmentState& first, const VkPipelineColorBlendAttachmentState& second)
+    {
+        return first.blendEnable == second.blendEnable && first.srcColorBlendFactor == second.srcColorBlendFactor
+            && first.dstColorBlendFactor == second.dstColorBlendFactor && first.colorBlendOp == second.colorBlendOp
+            && first.srcAlphaBlendFactor == second.srcAlphaBlendFactor && first.dstAlphaBlendFactor == second.dstAlphaBlendFactor
+            && first.alphaBlendOp == second.alphaBlendOp && first.colorWriteMask == second.colorWriteMask;
+    }
+
+    static void hashSpecializationConstants(size_t& seed, const VulkanSpecializationConstants& constants)
+    {
+        for (const auto& value : constants.getValues())
+        {
+            hashCombine(seed, value.first);
+
+            for (const auto byte : value.second)
+            {
+                hashCombine(seed, byte);
+            }
+        }
+    }
+};
+
+struct VulkanPipelineDescriptionHash
+{
+    size_t operator()(const VulkanPipelineDescription& description) const
+    {
+        return description.getHash();
+    }
+
+    size_t operator()(const VulkanPipelineLayoutDescription& description) const
+    {
+        return description.getHash();
+    }
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "thread_pool.h"
+#include "vulkan_pipeline_description.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Deduplicates pipelines and pipeline layouts by their description, users with equal state receive the same handles. Handles
+// are owned by the cache and stay valid until it is cleared or destroyed. The cache itself is not thread safe, only the
+// compilation of pipeline batches runs on other threads.
+class VulkanPipelineStateCache
+{
+public:
+    explicit VulkanPipelineStateCache(VkDevice device) :
+        VulkanPipelineStateCache(device, VK_NULL_HANDLE)
+    {}
+
+    // Pipelines missing from the state cache are still looked up in the pipeline cache before being compiled
+    explicit VulkanPipelineStateCache(VkDevice device, VkPipelineCache pipelineCache) :
+        VulkanPipelineStateCache(device, pipelineCache, 0)
+    {}
+
+    // Batches are compiled by a background thread together with the given number of workers, the pipeline cache is
+    // internally synchronized and shared by all of them
+    explicit VulkanPipelineStateCache(VkDevice device, VkPipelineCache pipelineCache, const uint32_t compileWorkerCount) :
+        device(device),
+        pipelineCache(pipelineCache),
+        compileThreadPool(compileWorkerCount),
+        hitCount(0),
+        missCount(0)
+    {}
+
+    ~VulkanPipelineStateCache()
+    {
+        clear();
+    }
+
+    // Render pass is only used when the pipeline has to be created, it has to be compatible with the description's color format.
+    // Waits if the pipeline is still being compiled by a batch. A failed compilation is rethrown once and then dropped from the
+    // cache, so transient errors such as running out of memory are retried by the next request.
+    VkPipeline getPipeline(const VulkanPipelineDescription& description, VkRenderPass renderPass)
+    {
+        const auto iterator = pipelines.find(description);
+
+        if (iterator != pipelines.end())
+        {
+            ++hitCount;
+
+            try
+            {
+                return iterator->second.get();
+            }
+            catch (...)
+            {
+                pipelines.erase(iterator);
+                throw;
+            }
+        }
+
+        ++missCount;
+        const VkPipeline pipeline = description.createPipeline(device, pipelineCache, renderPass, getPipelineLayout(description.getLayout()));
+        std::promise<VkPipeline> promise;
+        promise.set_value(pipeline);
+        pipelines.emplace(description, promise.get_future().share());
+        return pipeline;
+    }
+
+    // Starts compiling all pipelines which are not in the cache yet and returns without waiting, futures are returned in the order
+    // of descriptions and become ready one by one. Render pass has to stay valid until the batch is finished. Compilation errors
+    // are reported through the futures, pipelines whose earlier compilation has already failed are compiled again.
+    std::vector<std::shared_future<VkPipeline>> compilePipelines(const std::vector<VulkanPipelineDescription>& descriptions,
+        VkRenderPass renderPass)
+    {
+        std::vector<std::shared_future<VkPipeline>> result;
+        auto batch = std::make_shared<std::vector<CompileTask>>();
+
+        for (const auto& description : descriptions)
+        {
+            auto iterator = pipelines.find(description);
+
+            if (iterator != pipelines.end() && hasFailed(iterator->second))
+            {
+                pipelines.erase(iterator);
+                iterator = pipelines.end();
+            }
+
+            if (iterator != pipelines.end())
+            {
+                ++hitCount;
+                result.push_back(iterator->second);
+                continue;
+            }
+
+            ++missCount;
+            batch->push_back(CompileTask{description, getPipelineLayout(description.getLayout()), std::promise<VkPipeline>()});
+            const std::shared_future<VkPipeline> future = batch->back().promise.get_future().share();
+            pipelines.emplace(description, future);
+            result.push_back(future);
+        }
+
+        if (batch->empty())
+        {
+            return result;
+        }
+
+        // Batches run one after another, so the thread pool is never used from two threads at once
+        const std::shared_future<void> previousBatch = lastBatch;
+
+        lastBatch = std::async(std::launch::async, [this, batch, renderPass, previousBatch]()
+        {
+            if (previousBatch.valid())
+            {
+                previousBatch.wait();
+            }
+
+            compileThreadPool.parallelFor(batch->size(), [this, batch, renderPass](const size_t index, const uint32_t)
+            {
+                CompileTask& task = batch->at(index);
+
+                try
+                {
+                    task.promise.set_value(task.description.createPipeline(device, pipelineCache, renderPass, task.pipelineLayout));
+                }
+                catch (...)
+                {
+                    task.promise.set_exception(std::current_exception());
+                }
+            });
+        }).share();
+
+        return result;
+    }
+
+    // Blocks until all batches started so far are compiled
+    void waitForPipelines() const
+    {
+        if (lastBatch.valid())
+        {
+            lastBatch.wait();
+        }
+    }
+
+    VkPipelineLayout getPipelineLayout(const VulkanPipelineLayoutDescription& description)
+    {
+        const auto iterator = pipelineLayouts.find(description);
+
+        if (iterator != pipelineLayouts.end())
+        {
+            return iterator->second;
+        }
+
+        const VkPipelineLayout pipelineLayout = description.createPipelineLayout(device);
+        pipelineLayouts.emplace(description, pipelineLayout);
+        return pipelineLayout;
+    }
+
+    // None of the pipelines may be in use by the device
+    void clear()
+    {
+        waitForPipelines();
+
+        for (const auto& pipeline : pipelines)
+        {
+            // Pipelines which failed to compile have nothing to destroy
+            try
+            {
+                vkDestroyPipeline(device, pipeline.second.get(), nullptr);
+            }
+            catch (...)
+            {}
+        }
+
+        for (const auto& pipelineLayout : pipelineLayouts)
+        {
+            vkDestroyPipelineLayout(device, pipelineLayout.second, nullptr);
+        }
+
+        pipelines.clear();
+        pipelineLayouts.clear();
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkPipelineCache getPipelineCache() const
+    {
+        return pipelineCache;
+    }
+
+    size_t getPipelineCount() const
+    {
+        return pipelines.size();
+    }
+
+    size_t getPipelineLayoutCount() const
+    {
+        return pipelineLayouts.size();
+    }
+
+    uint32_t getCompileThreadCount() const
+    {
+        return compileThreadPool.getThreadCount();
+    }
+
+    // Number of pipeline requests served from the cache and number which created a new pipeline
+    uint64_t getHitCount() const
+    {
+        return hitCount;
+    }
+
+    uint64_t getMissCount() const
+    {
+        return missCount;
+    }
+
+private:
+    struct CompileTask
+    {
+        VulkanPipelineDescription description;
+        VkPipelineLayout pipelineLayout;
+        std::promise<VkPipeline> promise;
+    };
+
+    VkDevice device;
+    VkPipelineCache pipelineCache;
+    ThreadPool compileThreadPool;
+    std::shared_future<void> lastBatch;
+    std::unordered_map<VulkanPipelineDescription, std::shared_future<VkPipeline>, VulkanPipelineDescriptionHash> pipelines;
+    std::unordered_map<VulkanPipelineLayoutDescription, VkPipelineLayout, VulkanPipelineDescriptionHash> pipelineLayouts;
+    uint64_t hitCount;
+    uint64_t missCount;
+
+    // Pipelines which are still being compiled have not failed yet
+    static bool hasFailed(const std::shared_future<VkPipeline>& pipeline)
+    {
+        if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return false;
+        }
+
+        try
+        {
+            pipeline.get();
+            return false;
+        }
+        catch (...)
+        {
+            return true;
+        }
+    }
+};
+
+} // namespace VulkanLearning
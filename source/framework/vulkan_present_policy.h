@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace VulkanLearning
+{
+
+enum class VulkanPresentTarget
+{
+    // Newest frame is shown as soon as possible, tearing is accepted when no mailbox mode is available
+    LowLatency,
+    // Presentation is synchronized with vertical blank and as few images as possible are rendered ahead
+    PowerSaving,
+    // Every presented frame is shown for at least one vertical blank without tearing, throughput is preferred over latency
+    StrictVsync
+};
+
+// Chooses present mode and swap chain image count for the given target, optionally together with a frame rate limit which is
+// enforced on the host by FramePacer
+class VulkanPresentPolicy
+{
+public:
+    explicit VulkanPresentPolicy(const VulkanPresentTarget target) :
+        VulkanPresentPolicy(target, 0.0)
+    {}
+
+    // Frame rate limit of zero disables the limiter
+    explicit VulkanPresentPolicy(const VulkanPresentTarget target, const double frameRateLimit) :
+        target(target),
+        frameRateLimit(frameRateLimit)
+    {}
+
+    VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
+    {
+        // FIFO is the only mode which is always supported
+        switch (target)
+        {
+        case VulkanPresentTarget::LowLatency:
+            if (isAvailable(availablePresentModes, VK_PRESENT_MODE_MAILBOX_KHR))
+            {
+                return VK_PRESENT_MODE_MAILBOX_KHR;
+            }
+            if (isAvailable(availablePresentModes, VK_PRESENT_MODE_IMMEDIATE_KHR))
+            {
+                return VK_PRESENT_MODE_IMMEDIATE_KHR;
+            }
+            return VK_PRESENT_MODE_FIFO_KHR;
+        case VulkanPresentTarget::PowerSaving:
+        case VulkanPresentTarget::StrictVsync:
+        default:
+            return VK_PRESENT_MODE_FIFO_KHR;
+        }
+    }
+
+    // Count differs between targets and drivers may create more images than requested, so switching targets at runtime can change
+    // the number of swap chain images. Per-frame resources should be keyed by frame in flight instead.
+    uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities, const VkPresentModeKHR presentMode) const
+    {
+        // Mailbox needs a spare image to replace while another one is displayed, FIFO queues an extra image only when throughput
+        // is preferred, every other case keeps the present queue as short as possible
+        uint32_t imageCount = capabilities.minImageCount;
+
+        if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR || target == VulkanPresentTarget::StrictVsync)
+        {
+            imageCount++;
+        }
+
+        imageCount = std::max(imageCount, 2u);
+
+        if (capabilities.maxImageCount > 0)
+        {
+            imageCount = std::min(imageCount, capabilities.maxImageCount);
+        }
+
+        return imageCount;
+    }
+
+    VulkanPresentTarget getTarget() const
+    {
+        return target;
+    }
+
+    double getFrameRateLimit() const
+    {
+        return frameRateLimit;
+    }
+
+private:
+    VulkanPresentTarget target;
+    double frameRateLimit;
+
+    static bool isAvailable(const std::vector<VkPresentModeKHR>& availablePresentModes, const VkPresentModeKHR presentMode)
+    {
+        return std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end();
+    }
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include "vulkan/vulkan.h"
+
+namespace VulkanLearning
+{
+
+// Push constant range holding a single value of type T. The range is declared in the pipeline layout description and values
+// are recorded straight into command buffers, so per-draw data needs neither buffer writes nor descriptor updates. Devices
+// only guarantee 128 bytes of push constants in total.
+template <typename T>
+class VulkanPushConstants
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "Push constant type has to be trivially copyable");
+    static_assert(sizeof(T) % 4 == 0, "Push constant size has to be a multiple of 4");
+
+    explicit VulkanPushConstants(const VkShaderStageFlags stageFlags) :
+        VulkanPushConstants(stageFlags, 0)
+    {}
+
+    explicit VulkanPushConstants(const VkShaderStageFlags stageFlags, const uint32_t offset) :
+        stageFlags(stageFlags),
+        offset(offset)
+    {
+        if (offset % 4 != 0)
+        {
+            throw std::runtime_error("Push constant offset has to be a multiple of 4");
+        }
+    }
+
+    // Pipeline layout has to contain the range returned by getRange
+    void push(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const T& value) const
+    {
+        vkCmdPushConstants(commandBuffer, pipelineLayout, stageFlags, offset, getSize(), &value);
+    }
+
+    VkPushConstantRange getRange() const
+    {
+        return VkPushConstantRange{stageFlags, offset, getSize()};
+    }
+
+    VkShaderStageFlags getStageFlags() const
+    {
+        return stageFlags;
+    }
+
+    uint32_t getOffset() const
+    {
+        return offset;
+    }
+
+    uint32_t getSize() const
+    {
+        return static_cast<uint32_t>(sizeof(T));
+    }
+
+private:
+    VkShaderStageFlags stageFlags;
+    uint32_t offset;
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Value on a timeline semaphore, reached once all work submitted up to and including the value has finished
+class VulkanTimelinePoint
+{
+public:
+    explicit VulkanTimelinePoint(VkSemaphore semaphore, const uint64_t value) :
+        semaphore(semaphore),
+        value(value)
+    {}
+
+    VkSemaphore getSemaphore() const
+    {
+        return semaphore;
+    }
+
+    uint64_t getValue() const
+    {
+        return value;
+    }
+
+private:
+    VkSemaphore semaphore;
+    uint64_t value;
+};
+
+// Command buffers and semaphore dependencies of a single queue submission. Binary semaphores are only needed for interaction
+// with the swap chain, everything else waits on timeline points.
+class VulkanSubmission
+{
+public:
+    void addCommandBuffer(VkCommandBuffer commandBuffer)
+    {
+        commandBuffers.push_back(commandBuffer);
+    }
+
+    void waitTimeline(const VulkanTimelinePoint& point, const VkPipelineStageFlags stageMask)
+    {
+        addWait(point.getSemaphore(), point.getValue(), stageMask);
+    }
+
+    void waitSemaphore(VkSemaphore semaphore, const VkPipelineStageFlags stageMask)
+    {
+        addWait(semaphore, 0, stageMask);
+    }
+
+    void signalSemaphore(VkSemaphore semaphore)
+    {
+        signalSemaphores.push_back(semaphore);
+        signalValues.push_back(0);
+    }
+
+    const std::vector<VkCommandBuffer>& getCommandBuffers() const
+    {
+        return commandBuffers;
+    }
+
+    const std::vector<VkSemaphore>& getWaitSemaphores() const
+    {
+        return waitSemaphores;
+    }
+
+    const std::vector<uint64_t>& getWaitValues() const
+    {
+        return waitValues;
+    }
+
+    const std::vector<VkPipelineStageFlags>& getWaitStageMasks() const
+    {
+        return waitStageMasks;
+    }
+
+    const std::vector<VkSemaphore>& getSignalSemaphores() const
+    {
+        return signalSemaphores;
+    }
+
+    const std::vector<uint64_t>& getSignalValues() const
+    {
+        return signalValues;
+    }
+
+private:
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+    std::vector<VkSemaphore> signalSemaphores;
+    std::vector<uint64_t> signalValues;
+
+    void addWait(VkSemaphore semaphore, const uint64_t value, const VkPipelineStageFlags stageMask)
+    {
+        waitSemaphores.push_back(semaphore);
+        waitValues.push_back(value);
+        waitStageMasks.push_back(stageMask);
+    }
+};
+
+// Timeline semaphore attached to a queue, every submission made through it signals the next value. Work on other queues and
+// the host express dependencies by waiting for these values instead of idling the queue.
+class VulkanQueueTimeline
+{
+public:
+    explicit VulkanQueueTimeline(VkDevice device, VkQueue queue) :
+        device(device),
+        queue(queue),
+        lastSubmittedValue(0),
+        completedValue(0)
+    {
+        const VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            nullptr,
+            VK_SEMAPHORE_TYPE_TIMELINE,
+            0
+        };
+
+        const VkSemaphoreCreateInfo semaphoreCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            &semaphoreTypeCreateInfo,
+            0
+        };
+
+        checkVulkanError(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore), "vkCreateSemaphore");
+    }
+
+    ~VulkanQueueTimeline()
+    {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+
+    // Returns timeline value which is reached once the submission has finished
+    uint64_t submit(const VulkanSubmission& submission)
+    {
+        return submit(submission, VK_NULL_HANDLE);
+    }
+
+    uint64_t submit(const VulkanSubmission& submission, VkFence fence)
+    {
+        const uint64_t value = lastSubmittedValue + 1;
+
+        std::vector<VkSemaphore> signalSemaphores = submission.getSignalSemaphores();
+        std::vector<uint64_t> signalValues = submission.getSignalValues();
+        signalSemaphores.push_back(semaphore);
+        signalValues.push_back(value);
+
+        const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo =
+        {
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            nullptr,
+            static_cast<uint32_t>(submission.getWaitValues().size()),
+            submission.getWaitValues().data(),
+            static_cast<uint32_t>(signalValues.size()),
+            signalValues.data()
+        };
+
+        const VkSubmitInfo submitInfo =
+        {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            &timelineSubmitInfo,
+            static_cast<uint32_t>(submission.getWaitSemaphores().size()),
+            submission.getWaitSemaphores().data(),
+            submission.getWaitStageMasks().data(),
+            static_cast<uint32_t>(submission.getCommandBuffers().size()),
+            submission.getCommandBuffers().data(),
+            static_cast<uint32_t>(signalSemaphores.size()),
+            signalSemaphores.data()
+        };
+
+        checkVulkanError(vkQueueSubmit(queue, 1, &submitInfo, fence), "vkQueueSubmit");
+        lastSubmittedValue = value;
+        return value;
+    }
+
+    // Polls the semaphore without blocking
+    bool isComplete(const uint64_t value)
+    {
+        if (value > completedValue)
+        {
+            completedValue = getCompletedValue();
+        }
+
+        return value <= completedValue;
+    }
+
+    void wait(const uint64_t value)
+    {
+        if (isComplete(value))
+        {
+            return;
+        }
+
+        const VkSemaphoreWaitInfo waitInfo =
+        {
+            VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            nullptr,
+            0,
+            1,
+            &semaphore,
+            &value
+        };
+
+        checkVulkanError(vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max()), "vkWaitSemaphores");
+        completedValue = std::max(completedValue, value);
+    }
+
+    // Waits for all work submitted through the timeline, unlike vkQueueWaitIdle it ignores submissions made elsewhere
+    void waitIdle()
+    {
+        wait(lastSubmittedValue);
+    }
+
+    uint64_t getCompletedValue() const
+    {
+        uint64_t value;
+        checkVulkanError(vkGetSemaphoreCounterValue(device, semaphore, &value), "vkGetSemaphoreCounterValue");
+        return value;
+    }
+
+    VulkanTimelinePoint getPoint(const uint64_t value) const
+    {
+        return VulkanTimelinePoint(semaphore, value);
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkQueue getQueue() const
+    {
+        return queue;
+    }
+
+    VkSemaphore getSemaphore() const
+    {
+        return semaphore;
+    }
+
+    uint64_t getLastSubmittedValue() const
+    {
+        return lastSubmittedValue;
+    }
+
+private:
+    VkDevice device;
+    VkQueue queue;
+    VkSemaphore semaphore;
+    uint64_t lastSubmittedValue;
+    uint64_t completedValue;
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,625 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_barrier_batch.h"
+#include "vulkan_memory_allocation.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Records work for a single queue as passes which declare the images and buffers they read and write. Compilation culls passes
+// that do not contribute to an output, orders the remaining ones and derives the pipeline barriers and layout transitions between
+// them, so passes never place barriers by hand. A pass which depends on the previous contents of a resource it writes has to
+// declare a read as well, a write on its own is treated as a full overwrite.
+class VulkanRenderGraph
+{
+public:
+    VulkanRenderGraph() :
+        compiled(false)
+    {}
+
+    // Previous accesses to the image are derived from its initial layout
+    uint32_t importImage(VkImage image, const VkImageAspectFlags aspectMask, const VkImageLayout initialLayout,
+        const VkImageLayout finalLayout)
+    {
+        return importImage(image, aspectMask, initialLayout, getImageLayoutPipelineStage(initialLayout),
+            getImageLayoutAccessMask(initialLayout), finalLayout);
+    }
+
+    // Initial stage mask allows chaining with a semaphore wait, e.g. swap chain images acquired at color attachment output stage.
+    // Final layout of undefined leaves the image in the layout of its last access.
+    uint32_t importImage(VkImage image, const VkImageAspectFlags aspectMask, const VkImageLayout initialLayout,
+        const VkPipelineStageFlags initialStageMask, const VkAccessFlags initialAccessMask, const VkImageLayout finalLayout)
+    {
+        resources.push_back(Resource{VulkanResourceType::Image, VK_NULL_HANDLE, image, aspectMask, initialLayout, initialStageMask,
+            initialAccessMask, finalLayout, false});
+        compiled = false;
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    // Buffers are expected to be synchronized with earlier work through semaphores
+    uint32_t importBuffer(VkBuffer buffer)
+    {
+        resources.push_back(Resource{VulkanResourceType::Buffer, buffer, VK_NULL_HANDLE, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0,
+            VK_IMAGE_LAYOUT_UNDEFINED, false});
+        compiled = false;
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    uint32_t addPass(const std::string& name, const std::function<void(VkCommandBuffer)>& recordFunction)
+    {
+        passes.push_back(Pass{name, recordFunction, {}, {}, {}, false});
+        compiled = false;
+        return static_cast<uint32_t>(passes.size() - 1);
+    }
+
+    void readImage(const uint32_t pass, const uint32_t resource, const VkImageLayout layout)
+    {
+        readImage(pass, resource, layout, getImageLayoutPipelineStage(layout), getImageLayoutAccessMask(layout));
+    }
+
+    void readImage(const uint32_t pass, const uint32_t resource, const VkImageLayout layout, const VkPipelineStageFlags stageMask,
+        const VkAccessFlags accessMask)
+    {
+        addAccess(pass, resource, VulkanResourceType::Image, layout, stageMask, accessMask, false);
+    }
+
+    void writeImage(const uint32_t pass, const uint32_t resource, const VkImageLayout layout)
+    {
+        writeImage(pass, resource, layout, getImageLayoutPipelineStage(layout), getImageLayoutAccessMask(layout));
+    }
+
+    void writeImage(const uint32_t pass, const uint32_t resource, const VkImageLayout layout, const VkPipelineStageFlags stageMask,
+        const VkAccessFlags accessMask)
+    {
+        addAccess(pass, resource, VulkanResourceType::Image, layout, stageMask, accessMask, true);
+    }
+
+    void readBuffer(const uint32_t pass, const uint32_t resource, const VkPipelineStageFlags stageMask, const VkAccessFlags accessMask)
+    {
+        addAccess(pass, resource, VulkanResourceType::Buffer, VK_IMAGE_LAYOUT_UNDEFINED, stageMask, accessMask, false);
+    }
+
+    void writeBuffer(const uint32_t pass, const uint32_t resource, const VkPipelineStageFlags stageMask, const VkAccessFlags accessMask)
+    {
+        addAccess(pass, resource, VulkanResourceType::Buffer, VK_IMAGE_LAYOUT_UNDEFINED, stageMask, accessMask, true);
+    }
+
+    // Contents of output resources are used after the graph has executed, passes which do not lead to an output are culled
+    void markOutput(const uint32_t resource)
+    {
+        checkResource(resource);
+        resources[resource].output = true;
+        compiled = false;
+    }
+
+    void compile()
+    {
+        for (auto& pass : passes)
+        {
+            pass.used = true;
+        }
+
+        // Dependencies are found again after culling, so that ordering carried by a culled pass is not lost
+        findDependencies();
+        cullPasses();
+        findDependencies();
+        orderPasses();
+        computeBarriers();
+        compiled = true;
+    }
+
+    // Compiled graph can be recorded into any number of command buffers
+    void execute(VkCommandBuffer commandBuffer) const
+    {
+        if (!compiled)
+        {
+            throw std::runtime_error("Render graph has to be compiled before it is executed");
+        }
+
+        for (size_t i = 0; i < executionOrder.size(); ++i)
+        {
+            passBarriers[i].record(commandBuffer);
+            passes[executionOrder[i]].recordFunction(commandBuffer);
+        }
+
+        finalBarriers.record(commandBuffer);
+    }
+
+    void clear()
+    {
+        resources.clear();
+        passes.clear();
+        compiled = false;
+    }
+
+    bool isCompiled() const
+    {
+        return compiled;
+    }
+
+    bool isPassCulled(const uint32_t pass) const
+    {
+        checkPass(pass);
+        return !passes[pass].used;
+    }
+
+    const std::string& getPassName(const uint32_t pass) const
+    {
+        checkPass(pass);
+        return passes[pass].name;
+    }
+
+    size_t getPassCount() const
+    {
+        return passes.size();
+    }
+
+    size_t getResourceCount() const
+    {
+        return resources.size();
+    }
+
+    const std::vector<uint32_t>& getExecutionOrder() const
+    {
+        return executionOrder;
+    }
+
+    // Number of vkCmdPipelineBarrier calls recorded by execute
+    uint32_t getBarrierBatchCount() const
+    {
+        uint32_t count = finalBarriers.isEmpty() ? 0 : 1;
+
+        for (const auto& batch : passBarriers)
+        {
+            if (!batch.isEmpty())
+            {
+                ++count;
+            }
+        }
+
+        return count;
+    }
+
+private:
+    struct Resource
+    {
+        VulkanResourceType type;
+        VkBuffer buffer;
+        VkImage image;
+        VkImageAspectFlags aspectMask;
+        VkImageLayout initialLayout;
+        VkPipelineStageFlags initialStageMask;
+        VkAccessFlags initialAccessMask;
+        VkImageLayout finalLayout;
+        bool output;
+    };
+
+    struct Access
+    {
+        uint32_t resource;
+        VkImageLayout layout;
+        VkPipelineStageFlags stageMask;
+        VkAccessFlags accessMask;
+        bool read;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::function<void(VkCommandBuffer)> recordFunction;
+        std::vector<Access> accesses;
+        // Passes which have to execute earlier, producers are the subset whose results are read
+        std::vector<uint32_t> dependencies;
+        std::vector<uint32_t> producers;
+        bool used;
+    };
+
+    // Last writes and reads of a resource at the current point of execution
+    struct ResourceState
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStageMask;
+        VkAccessFlags writeAccessMask;
+        VkPipelineStageFlags readStageMask;
+        VkPipelineStageFlags visibleStageMask;
+        VkAccessFlags visibleAccessMask;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<uint32_t> executionOrder;
+    std::vector<VulkanBarrierBatch> passBarriers;
+    VulkanBarrierBatch finalBarriers;
+    bool compiled;
+
+    void addAccess(const uint32_t pass, const uint32_t resource, const VulkanResourceType type, const VkImageLayout layout,
+        const VkPipelineStageFlags stageMask, const VkAccessFlags accessMask, const bool write)
+    {
+        checkPass(pass);
+        checkResource(resource);
+
+        if (resources[resource].type != type)
+        {
+            throw std::runtime_error("Render graph resource is accessed as the wrong type");
+        }
+
+        compiled = false;
+
+        // Multiple accesses of the same resource within a pass are merged, they have to agree on the layout
+        for (auto& access : passes[pass].accesses)
+        {
+            if (access.resource != resource)
+            {
+                continue;
+            }
+
+            if (access.layout != layout)
+            {
+                throw std::runtime_error("Render graph pass accesses an image in multiple layouts");
+            }
+
+            access.stageMask |= stageMask;
+            access.accessMask |= accessMask;
+            access.read = access.read || !write;
+            access.write = access.write || write;
+            return;
+        }
+
+        passes[pass].accesses.push_back(Access{resource, layout, stageMask, accessMask, !write, write});
+    }
+
+    void findDependencies()
+    {
+        std::vector<int64_t> lastWriters(resources.size(), -1);
+        std::vector<std::vector<uint32_t>> lastReaders(resources.size());
+
+        for (uint32_t i = 0; i < passes.size(); ++i)
+        {
+            Pass& pass = passes[i];
+
+            if (!pass.used)
+            {
+                continue;
+            }
+
+            pass.dependencies.clear();
+            pass.producers.clear();
+
+            for (const auto& access : pass.accesses)
+            {
+                const int64_t lastWriter = lastWriters[access.resource];
+
+                if (lastWriter >= 0)
+                {
+                    addUnique(pass.dependencies, static_cast<uint32_t>(lastWriter));
+
+                    if (access.read)
+                    {
+                        addUnique(pass.producers, static_cast<uint32_t>(lastWriter));
+                    }
+                }
+
+                if (access.write)
+                {
+                    for (const uint32_t reader : lastReaders[access.resource])
+                    {
+                        if (reader != i)
+                        {
+                            addUnique(pass.dependencies, reader);
+                        }
+                    }
+                }
+            }
+
+            for (const auto& access : pass.accesses)
+            {
+                if (access.write)
+                {
+                    lastWriters[access.resource] = i;
+                    lastReaders[access.resource].clear();
+                }
+                else
+                {
+                    lastReaders[access.resource].push_back(i);
+                }
+            }
+        }
+    }
+
+    void cullPasses()
+    {
+        std::vector<uint32_t> pendingPasses;
+
+        for (auto& pass : passes)
+        {
+            pass.used = false;
+        }
+
+        // Last writer of every output is needed, earlier writers only if their results are read by a needed pass
+        for (uint32_t resource = 0; resource < resources.size(); ++resource)
+        {
+            if (!resources[resource].output)
+            {
+                continue;
+            }
+
+            for (uint32_t i = static_cast<uint32_t>(passes.size()); i > 0; --i)
+            {
+                if (writes(passes[i - 1], resource))
+                {
+                    pendingPasses.push_back(i - 1);
+                    break;
+                }
+            }
+        }
+
+        while (!pendingPasses.empty())
+        {
+            const uint32_t pass = pendingPasses.back();
+            pendingPasses.pop_back();
+
+            if (passes[pass].used)
+            {
+                continue;
+            }
+
+            passes[pass].used = true;
+            pendingPasses.insert(pendingPasses.end(), passes[pass].producers.begin(), passes[pass].producers.end());
+        }
+    }
+
+    // Among the passes whose dependencies have executed, the one whose latest dependency executed earliest goes first. Independent
+    // work then ends up between producers and consumers, which gives barriers time to resolve without stalling the queue.
+    void orderPasses()
+    {
+        std::vector<int64_t> positions(passes.size(), -1);
+        std::vector<uint32_t> pendingPasses;
+        executionOrder.clear();
+
+        for (uint32_t i = 0; i < passes.size(); ++i)
+        {
+            if (passes[i].used)
+            {
+                pendingPasses.push_back(i);
+            }
+        }
+
+        while (!pendingPasses.empty())
+        {
+            size_t bestIndex = pendingPasses.size();
+            int64_t bestPosition = 0;
+
+            for (size_t i = 0; i < pendingPasses.size(); ++i)
+            {
+                int64_t latestPosition = -1;
+
+                if (!getLatestDependencyPosition(passes[pendingPasses[i]], positions, latestPosition))
+                {
+                    continue;
+                }
+
+                if (bestIndex == pendingPasses.size() || latestPosition < bestPosition)
+                {
+                    bestIndex = i;
+                    bestPosition = latestPosition;
+                }
+            }
+
+            if (bestIndex == pendingPasses.size())
+            {
+                throw std::runtime_error("Render graph contains a dependency cycle");
+            }
+
+            const uint32_t pass = pendingPasses[bestIndex];
+            positions[pass] = static_cast<int64_t>(executionOrder.size());
+            executionOrder.push_back(pass);
+            pendingPasses.erase(pendingPasses.begin() + bestIndex);
+        }
+    }
+
+    // Returns false if some dependency has not executed yet
+    static bool getLatestDependencyPosition(const Pass& pass, const std::vector<int64_t>& positions, int64_t& latestPosition)
+    {
+        for (const uint32_t dependency : pass.dependencies)
+        {
+            if (positions[dependency] < 0)
+            {
+                return false;
+            }
+
+            latestPosition = std::max(latestPosition, positions[dependency]);
+        }
+
+        return true;
+    }
+
+    void computeBarriers()
+    {
+        std::vector<ResourceState> states;
+
+        for (const auto& resource : resources)
+        {
+            states.push_back(ResourceState{resource.initialLayout, resource.initialStageMask, resource.initialAccessMask, 0, 0, 0});
+        }
+
+        passBarriers.clear();
+
+        for (const uint32_t pass : executionOrder)
+        {
+            VulkanBarrierBatch batch;
+
+            for (const auto& access : passes[pass].accesses)
+            {
+                addAccessBarrier(access, states[access.resource], batch);
+            }
+
+            passBarriers.push_back(batch);
+        }
+
+        finalBarriers.clear();
+
+        for (uint32_t i = 0; i < resources.size(); ++i)
+        {
+            const Resource& resource = resources[i];
+            const ResourceState& state = states[i];
+
+            if (resource.type != VulkanResourceType::Image || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+                || resource.finalLayout == state.layout)
+            {
+                continue;
+            }
+
+            addBarrier(finalBarriers, resource, state.writeStageMask | state.readStageMask, state.writeAccessMask,
+                getImageLayoutPipelineStage(resource.finalLayout), getImageLayoutAccessMask(resource.finalLayout), state.layout,
+                resource.finalLayout);
+        }
+    }
+
+    // Layout transitions and hazards after writes need a barrier, reads which are already visible do not
+    void addAccessBarrier(const Access& access, ResourceState& state, VulkanBarrierBatch& batch)
+    {
+        const Resource& resource = resources[access.resource];
+
+        if (resource.type == VulkanResourceType::Image && access.layout != state.layout)
+        {
+            addBarrier(batch, resource, state.writeStageMask | state.readStageMask, state.writeAccessMask, access.stageMask,
+                access.accessMask, state.layout, access.layout);
+
+            // Layout transition is a write which completes before the destination stages and is visible to them. A writing pass makes
+            // the contents stale again, so nothing is visible until the next barrier.
+            if (access.write)
+            {
+                state = ResourceState{access.layout, access.stageMask, access.accessMask, 0, 0, 0};
+            }
+            else
+            {
+                state = ResourceState{access.layout, access.stageMask, 0, access.stageMask, access.stageMask, access.accessMask};
+            }
+
+            return;
+        }
+
+        if (!access.write)
+        {
+            const bool visible = (access.stageMask & ~state.visibleStageMask) == 0 && (access.accessMask & ~state.visibleAccessMask) == 0;
+
+            if (state.writeStageMask != 0 && !visible)
+            {
+                addBarrier(batch, resource, state.writeStageMask, state.writeAccessMask, access.stageMask, access.accessMask, state.layout,
+                    state.layout);
+                state.visibleStageMask |= access.stageMask;
+                state.visibleAccessMask |= access.accessMask;
+            }
+
+            state.readStageMask |= access.stageMask;
+            return;
+        }
+
+        // Write after read only needs an execution dependency, write after write also needs the previous writes to be available
+        const VkPipelineStageFlags sourceStageMask = state.writeStageMask | state.readStageMask;
+
+        if (sourceStageMask != 0)
+        {
+            addBarrier(batch, resource, sourceStageMask, state.writeAccessMask, access.stageMask, access.accessMask, state.layout,
+                state.layout);
+        }
+
+        // A write is not visible to anything, including later reads through the same stages and accesses
+        state = ResourceState{state.layout, access.stageMask, access.accessMask, 0, 0, 0};
+    }
+
+    static void addBarrier(VulkanBarrierBatch& batch, const Resource& resource, const VkPipelineStageFlags sourceStageMask,
+        const VkAccessFlags sourceAccessMask, const VkPipelineStageFlags destinationStageMask, const VkAccessFlags destinationAccessMask,
+        const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    {
+        if (resource.type == VulkanResourceType::Buffer)
+        {
+            const VkBufferMemoryBarrier barrier =
+            {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                nullptr,
+                sourceAccessMask,
+                destinationAccessMask,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                resource.buffer,
+                0,
+                VK_WHOLE_SIZE
+            };
+
+            batch.addBufferBarrier(barrier, sourceStageMask, destinationStageMask);
+            return;
+        }
+
+        const VkImageMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            nullptr,
+            sourceAccessMask,
+            destinationAccessMask,
+            oldLayout,
+            newLayout,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            resource.image,
+            VkImageSubresourceRange
+            {
+                resource.aspectMask,
+                0,
+                VK_REMAINING_MIP_LEVELS,
+                0,
+                VK_REMAINING_ARRAY_LAYERS
+            }
+        };
+
+        batch.addImageBarrier(barrier, sourceStageMask, destinationStageMask);
+    }
+
+    static bool writes(const Pass& pass, const uint32_t resource)
+    {
+        for (const auto& access : pass.accesses)
+        {
+            if (access.resource == resource && access.write)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static void addUnique(std::vector<uint32_t>& values, const uint32_t value)
+    {
+        if (std::find(values.begin(), values.end(), value) == values.end())
+        {
+            values.push_back(value);
+        }
+    }
+
+    void checkPass(const uint32_t pass) const
+    {
+        if (pass >= passes.size())
+        {
+            throw std::runtime_error("Invalid render graph pass");
+        }
+    }
+
+    void checkResource(const uint32_t resource) const
+    {
+        if (resource >= resources.size())
+        {
+            throw std::runtime_error("Invalid render graph resource");
+        }
+    }
+};
+
+} // namespace VulkanLearning
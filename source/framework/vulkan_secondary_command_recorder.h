@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "thread_pool.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Records secondary command buffers on all threads of a thread pool. Command pools are externally synchronized, so every
+// thread allocates from its own pool and keeps its own list of command buffers, which are reused after reset.
+class VulkanSecondaryCommandRecorder
+{
+public:
+    explicit VulkanSecondaryCommandRecorder(VkDevice device, const uint32_t queueFamilyIndex, ThreadPool& threadPool) :
+        VulkanSecondaryCommandRecorder(device, queueFamilyIndex, 0, threadPool)
+    {}
+
+    // Pools which are reset every frame should be created with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+    explicit VulkanSecondaryCommandRecorder(VkDevice device, const uint32_t queueFamilyIndex,
+        const VkCommandPoolCreateFlags commandPoolCreateFlags, ThreadPool& threadPool) :
+        device(device),
+        threadPool(threadPool),
+        usedCommandBufferCounts(threadPool.getThreadCount(), 0),
+        threadCommandBuffers(threadPool.getThreadCount())
+    {
+        for (uint32_t i = 0; i < threadPool.getThreadCount(); ++i)
+        {
+            commandPools.push_back(std::make_unique<VulkanCommandPool>(device, queueFamilyIndex, commandPoolCreateFlags));
+        }
+    }
+
+    ~VulkanSecondaryCommandRecorder()
+    {
+        for (size_t i = 0; i < commandPools.size(); ++i)
+        {
+            if (!threadCommandBuffers[i].empty())
+            {
+                vkFreeCommandBuffers(device, commandPools[i]->getCommandPool(), static_cast<uint32_t>(threadCommandBuffers[i].size()),
+                    threadCommandBuffers[i].data());
+            }
+        }
+    }
+
+    // Records taskCount command buffers per framebuffer in parallel, each of them continues the given render pass. Returned
+    // command buffers are grouped by framebuffer in task order and stay valid until reset is called.
+    std::vector<std::vector<VkCommandBuffer>> record(VkRenderPass renderPass, const std::vector<VkFramebuffer>& framebuffers,
+        const size_t taskCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& recordFunction)
+    {
+        std::vector<std::vector<VkCommandBuffer>> result(framebuffers.size(), std::vector<VkCommandBuffer>(taskCount, VK_NULL_HANDLE));
+
+        threadPool.parallelFor(framebuffers.size() * taskCount, [&](const size_t index, const uint32_t threadIndex)
+        {
+            const size_t framebufferIndex = index / taskCount;
+            const size_t taskIndex = index % taskCount;
+            VkCommandBuffer commandBuffer = acquireCommandBuffer(threadIndex);
+
+            const VkCommandBufferInheritanceInfo inheritanceInfo =
+            {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+                nullptr,
+                renderPass,
+                0,
+                framebuffers.at(framebufferIndex),
+                VK_FALSE,
+                0,
+                0
+            };
+
+            const VkCommandBufferBeginInfo commandBufferBeginInfo =
+            {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                nullptr,
+                VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                &inheritanceInfo
+            };
+
+            checkVulkanError(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "vkBeginCommandBuffer");
+            recordFunction(commandBuffer, framebufferIndex, taskIndex);
+            checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+            result[framebufferIndex][taskIndex] = commandBuffer;
+        });
+
+        return result;
+    }
+
+    // Returns all command buffers to their pools, none of them may be pending execution
+    void reset()
+    {
+        for (size_t i = 0; i < commandPools.size(); ++i)
+        {
+            commandPools[i]->resetCommandPool();
+            usedCommandBufferCounts[i] = 0;
+        }
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    uint32_t getThreadCount() const
+    {
+        return threadPool.getThreadCount();
+    }
+
+    size_t getAllocatedCommandBufferCount() const
+    {
+        size_t count = 0;
+
+        for (const auto& commandBuffers : threadCommandBuffers)
+        {
+            count += commandBuffers.size();
+        }
+
+        return count;
+    }
+
+private:
+    VkDevice device;
+    ThreadPool& threadPool;
+    std::vector<std::unique_ptr<VulkanCommandPool>> commandPools;
+    std::vector<size_t> usedCommandBufferCounts;
+    std::vector<std::vector<VkCommandBuffer>> threadCommandBuffers;
+
+    // Only touches the lists of the given thread, so it can be called from all threads at once
+    VkCommandBuffer acquireCommandBuffer(const uint32_t threadIndex)
+    {
+        std::vector<VkCommandBuffer>& commandBuffers = threadCommandBuffers[threadIndex];
+        size_t& usedCount = usedCommandBufferCounts[threadIndex];
+
+        if (usedCount == commandBuffers.size())
+        {
+            const VkCommandBufferAllocateInfo commandBufferAllocateInfo =
+            {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                nullptr,
+                commandPools[threadIndex]->getCommandPool(),
+                VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                1
+            };
+
+            VkCommandBuffer commandBuffer;
+            checkVulkanError(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer), "vkAllocateCommandBuffers");
+            commandBuffers.push_back(commandBuffer);
+        }
+
+        return commandBuffers[usedCount++];
+    }
+};
+
+} // namespace VulkanLearning
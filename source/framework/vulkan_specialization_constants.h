@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace VulkanLearning
+{
+
+// Values of specialization constants for one shader stage, keyed by constant id. Setting the same id again replaces its value.
+// Entries are kept ordered by id, so equal sets of constants always produce the same specialization data.
+class VulkanSpecializationConstants
+{
+public:
+    VulkanSpecializationConstants()
+    {}
+
+    template <typename T>
+    void setConstant(const uint32_t constantId, const T value)
+    {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Unsupported specialization constant type");
+        setConstantData(constantId, &value, sizeof(value));
+    }
+
+    // Boolean constants are 32 bits wide in SPIR-V
+    void setConstant(const uint32_t constantId, const bool value)
+    {
+        const VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+        setConstantData(constantId, &boolValue, sizeof(boolValue));
+    }
+
+    bool isEmpty() const
+    {
+        return values.empty();
+    }
+
+    size_t getConstantCount() const
+    {
+        return values.size();
+    }
+
+    // Returned structure points into this object and is invalidated by setting a constant
+    VkSpecializationInfo getSpecializationInfo() const
+    {
+        return VkSpecializationInfo
+        {
+            static_cast<uint32_t>(mapEntries.size()),
+            mapEntries.data(),
+            data.size(),
+            data.data()
+        };
+    }
+
+    const std::map<uint32_t, std::vector<uint8_t>>& getValues() const
+    {
+        return values;
+    }
+
+    bool operator==(const VulkanSpecializationConstants& other) const
+    {
+        return values == other.values;
+    }
+
+    bool operator!=(const VulkanSpecializationConstants& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    std::map<uint32_t, std::vector<uint8_t>> values;
+    std::vector<VkSpecializationMapEntry> mapEntries;
+    std::vector<uint8_t> data;
+
+    void setConstantData(const uint32_t constantId, const void* source, const size_t size)
+    {
+        std::vector<uint8_t> value(size);
+        std::memcpy(value.data(), source, size);
+        values[constantId] = value;
+
+        mapEntries.clear();
+        data.clear();
+
+        for (const auto& entry : values)
+        {
+            mapEntries.push_back(VkSpecializationMapEntry{entry.first, static_cast<uint32_t>(data.size()), entry.second.size()});
+            data.insert(data.end(), entry.second.begin(), entry.second.end());
+        }
+    }
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "free_list_allocator.h"
+#include "vulkan_buffer.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_sync_object_pool.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+class VulkanStagingRegion
+{
+public:
+    explicit VulkanStagingRegion(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, void* mappedData) :
+        buffer(buffer),
+        offset(offset),
+        size(size),
+        mappedData(mappedData)
+    {}
+
+    VkBuffer getBuffer() const
+    {
+        return buffer;
+    }
+
+    VkDeviceSize getOffset() const
+    {
+        return offset;
+    }
+
+    VkDeviceSize getSize() const
+    {
+        return size;
+    }
+
+    void* getMappedData() const
+    {
+        return mappedData;
+    }
+
+private:
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mappedData;
+};
+
+// Ring of host visible memory used as the source of all host to device uploads. Regions are handed out in order and
+// space is reclaimed once the fence of the submission that consumed them has signaled.
+class VulkanStagingBuffer
+{
+public:
+    static const VkDeviceSize defaultAlignment = 16;
+
+    explicit VulkanStagingBuffer(VkDevice device, VulkanMemoryAllocator& allocator, VulkanSyncObjectPool& syncObjectPool,
+        const VkDeviceSize bufferSize) :
+        device(device),
+        syncObjectPool(syncObjectPool),
+        buffer(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, bufferSize),
+        bufferSize(bufferSize),
+        head(0),
+        tail(0),
+        pendingRegions(false),
+        lastSubmissionId(0)
+    {
+        buffer.allocateMemory(allocator, VulkanMemoryUsage::CpuToGpu);
+    }
+
+    ~VulkanStagingBuffer()
+    {
+        for (const auto& segment : segments)
+        {
+            syncObjectPool.releaseFence(segment.fence);
+        }
+    }
+
+    VulkanStagingRegion allocate(const VkDeviceSize dataSize)
+    {
+        return allocate(dataSize, defaultAlignment);
+    }
+
+    VulkanStagingRegion allocate(const VkDeviceSize dataSize, const VkDeviceSize alignment)
+    {
+        if (dataSize > bufferSize)
+        {
+            throw std::runtime_error("Upload does not fit into the staging buffer");
+        }
+
+        VkDeviceSize offset;
+        retireSegments(false);
+
+        while (!findSpace(dataSize, alignment, offset))
+        {
+            if (segments.empty())
+            {
+                throw std::runtime_error("Staging buffer is full of unsubmitted uploads");
+            }
+
+            retireSegments(true);
+        }
+
+        head = offset + dataSize;
+        pendingRegions = true;
+        return VulkanStagingRegion(buffer.getBuffer(), offset, dataSize, static_cast<uint8_t*>(buffer.getMappedData()) + offset);
+    }
+
+    VulkanStagingRegion uploadData(const void* source, const VkDeviceSize dataSize)
+    {
+        return uploadData(source, dataSize, defaultAlignment);
+    }
+
+    VulkanStagingRegion uploadData(const void* source, const VkDeviceSize dataSize, const VkDeviceSize alignment)
+    {
+        VulkanStagingRegion region = allocate(dataSize, alignment);
+        buffer.uploadData(source, dataSize, region.getOffset());
+        return region;
+    }
+
+    // Closes the regions allocated so far, the returned fence has to be signaled by the submission which reads them
+    VkFence acquireSubmissionFence()
+    {
+        const VkFence fence = syncObjectPool.acquireFence();
+        lastSubmissionId++;
+        segments.push_back(Segment{fence, head, lastSubmissionId});
+        pendingRegions = false;
+        return fence;
+    }
+
+    // Identifier of the submission which received the last fence from acquireSubmissionFence
+    uint64_t getLastSubmissionId() const
+    {
+        return lastSubmissionId;
+    }
+
+    bool isSubmissionComplete(const uint64_t submissionId)
+    {
+        retireSegments(false);
+        return segments.empty() || segments.front().submissionId > submissionId;
+    }
+
+    void waitForSubmission(const uint64_t submissionId)
+    {
+        while (!segments.empty() && segments.front().submissionId <= submissionId)
+        {
+            retireSegments(true);
+        }
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VulkanSyncObjectPool& getSyncObjectPool()
+    {
+        return syncObjectPool;
+    }
+
+    VkBuffer getBuffer() const
+    {
+        return buffer.getBuffer();
+    }
+
+    VkDeviceSize getBufferSize() const
+    {
+        return bufferSize;
+    }
+
+private:
+    struct Segment
+    {
+        VkFence fence;
+        VkDeviceSize end;
+        uint64_t submissionId;
+    };
+
+    VkDevice device;
+    VulkanSyncObjectPool& syncObjectPool;
+    VulkanBuffer buffer;
+    VkDeviceSize bufferSize;
+    VkDeviceSize head;
+    VkDeviceSize tail;
+    bool pendingRegions;
+    uint64_t lastSubmissionId;
+    std::deque<Segment> segments;
+
+    bool isEmpty() const
+    {
+        return segments.empty() && !pendingRegions;
+    }
+
+    bool findSpace(const VkDeviceSize dataSize, const VkDeviceSize alignment, VkDeviceSize& offset)
+    {
+        if (isEmpty())
+        {
+            head = 0;
+            tail = 0;
+        }
+
+        offset = FreeListAllocator::alignOffset(head, alignment);
+
+        if (isEmpty() || head > tail)
+        {
+            if (offset + dataSize <= bufferSize)
+            {
+                return true;
+            }
+
+            // wrap around, the space left at the end of the buffer stays unused until the tail passes it
+            offset = 0;
+            return dataSize <= tail;
+        }
+
+        return head < tail && offset + dataSize <= tail;
+    }
+
+    void retireSegments(const bool waitForOldest)
+    {
+        if (waitForOldest && !segments.empty())
+        {
+            checkVulkanError(vkWaitForFences(device, 1, &segments.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max()),
+                "vkWaitForFences");
+        }
+
+        while (!segments.empty() && vkGetFenceStatus(device, segments.front().fence) == VK_SUCCESS)
+        {
+            tail = segments.front().end;
+            syncObjectPool.releaseFence(segments.front().fence);
+            segments.pop_front();
+        }
+    }
+};
+
+} // namespace VulkanLearning
@@ -3,7 +3,10 @@
 #include <cstdint>
 #include <vector>
 #include "vulkan/vulkan.h"
+#include "vulkan_present_policy.h"
+#include "vulkan_queue_timeline.h"
 #include "vulkan_swap_chain_info.h"
+#include "vulkan_sync_object_pool.h"
 #include "vulkan_utility.h"
 
 namespace VulkanLearning
@@ -12,14 +15,21 @@ namespace VulkanLearning
 class VulkanSwapChain
 {
 public:
-    explicit VulkanSwapChain(VkDevice device, VkSurfaceKHR surface, const VulkanSwapChainInfo& swapChainInfo,
-        const VkImageUsageFlags imageUsageFlags) :
+    explicit VulkanSwapChain(VkDevice device, VulkanSyncObjectPool& syncObjectPool, VkSurfaceKHR surface,
+        const VulkanSwapChainInfo& swapChainInfo, const VkImageUsageFlags imageUsageFlags) :
+        VulkanSwapChain(device, syncObjectPool, surface, swapChainInfo, imageUsageFlags, VulkanPresentPolicy(VulkanPresentTarget::LowLatency))
+    {}
+
+    explicit VulkanSwapChain(VkDevice device, VulkanSyncObjectPool& syncObjectPool, VkSurfaceKHR surface,
+        const VulkanSwapChainInfo& swapChainInfo, const VkImageUsageFlags imageUsageFlags, const VulkanPresentPolicy& presentPolicy) :
         device(device),
+        syncObjectPool(syncObjectPool),
         surface(surface),
         swapChainInfo(swapChainInfo),
-        imageUsageFlags(imageUsageFlags)
+        imageUsageFlags(imageUsageFlags),
+        presentPolicy(presentPolicy)
     {
-        initializeSwapChain(swapChainInfo, chooseExtent(swapChainInfo.getSurfaceCapabilities()), imageUsageFlags);
+        initializeSwapChain(swapChainInfo, chooseExtent(swapChainInfo.getSurfaceCapabilities()), imageUsageFlags, VK_NULL_HANDLE);
     }
 
     ~VulkanSwapChain()
@@ -27,19 +37,78 @@ public:
         destroySwapChain();
     }
 
+    // Device has to be idle
     void destroySwapChain()
     {
-        for (size_t i = 0; i < imageViews.size(); i++)
+        for (const auto& retiredSwapChain : retiredSwapChains)
         {
-            vkDestroyImageView(device, imageViews.at(i), nullptr);
+            destroySwapChain(retiredSwapChain.swapChain, retiredSwapChain.imageViews, retiredSwapChain.renderFinishedSemaphores);
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        retiredSwapChains.clear();
+        destroySwapChain(swapChain, imageViews, renderFinishedSemaphores);
+        renderFinishedSemaphores.clear();
+    }
+
+    // Creates new swap chain which takes over the presentable images of the current one. The graphics timeline does not track
+    // presentation, and work submitted before the next frame does not imply that the old presents finished. So the current swap
+    // chain is retired until markFramePresented reports the first frame presented on the new one. It is destroyed once the timeline
+    // reaches that frame's submission value.
+    void recreateSwapChain(const VulkanSwapChainInfo& swapChainInfo)
+    {
+        retiredSwapChains.push_back(RetiredSwapChain{swapChain, imageViews, renderFinishedSemaphores, 0});
+        this->swapChainInfo = swapChainInfo;
+        initializeSwapChain(swapChainInfo, chooseExtent(swapChainInfo.getSurfaceCapabilities()), imageUsageFlags, swapChain);
+    }
+
+    // Submission value belongs to a frame which was rendered into an image of the current swap chain and presented successfully
+    void markFramePresented(const uint64_t submissionValue)
+    {
+        for (auto& retiredSwapChain : retiredSwapChains)
+        {
+            if (retiredSwapChain.retireValue == 0)
+            {
+                retiredSwapChain.retireValue = submissionValue;
+            }
+        }
+    }
+
+    void releaseRetiredSwapChains(VulkanQueueTimeline& timeline)
+    {
+        auto retiredSwapChain = retiredSwapChains.begin();
+
+        while (retiredSwapChain != retiredSwapChains.end())
+        {
+            if (retiredSwapChain->retireValue == 0 || !timeline.isComplete(retiredSwapChain->retireValue))
+            {
+                retiredSwapChain++;
+                continue;
+            }
+
+            destroySwapChain(retiredSwapChain->swapChain, retiredSwapChain->imageViews, retiredSwapChain->renderFinishedSemaphores);
+            retiredSwapChain = retiredSwapChains.erase(retiredSwapChain);
+        }
     }
 
-    void reloadSwapChain(const VulkanSwapChainInfo& swapChainInfo)
+    // New policy takes effect when the swap chain is recreated
+    void setPresentPolicy(const VulkanPresentPolicy& presentPolicy)
     {
-        initializeSwapChain(swapChainInfo, chooseExtent(swapChainInfo.getSurfaceCapabilities()), imageUsageFlags);
+        this->presentPolicy = presentPolicy;
+    }
+
+    const VulkanPresentPolicy& getPresentPolicy() const
+    {
+        return presentPolicy;
+    }
+
+    VkPresentModeKHR getPresentMode() const
+    {
+        return presentMode;
+    }
+
+    uint32_t getRetiredSwapChainCount() const
+    {
+        return static_cast<uint32_t>(retiredSwapChains.size());
     }
 
     VkDevice getDevice() const
@@ -77,17 +146,37 @@ public:
         return imageViews;
     }
 
+    // Signaled by the submission which renders into the image and waited on by its present. The image is acquired again only
+    // after that present, so the semaphore never has a pending wait when it is signaled.
+    VkSemaphore getRenderFinishedSemaphore(const uint32_t imageIndex) const
+    {
+        return renderFinishedSemaphores.at(imageIndex);
+    }
+
 private:
+    struct RetiredSwapChain
+    {
+        VkSwapchainKHR swapChain;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkSemaphore> renderFinishedSemaphores;
+        // Zero until a frame has been presented on a newer swap chain
+        uint64_t retireValue;
+    };
+
     VkDevice device;
+    VulkanSyncObjectPool& syncObjectPool;
     VkSurfaceKHR surface;
     VkSwapchainKHR swapChain;
-    VkSwapchainKHR helperSwapChain;
+    std::vector<RetiredSwapChain> retiredSwapChains;
     VkSurfaceFormatKHR surfaceFormat;
+    VkPresentModeKHR presentMode;
     VkExtent2D extent;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> imageViews;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
     VulkanSwapChainInfo swapChainInfo;
     VkImageUsageFlags imageUsageFlags;
+    VulkanPresentPolicy presentPolicy;
 
     VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) const
     {
@@ -113,22 +202,25 @@ private:
         return availableFormats.at(0);
     }
 
-    VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
+    VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const
     {
-        for (const auto& presentMode : availablePresentModes)
+        return capabilities.currentExtent;
+    }
+
+    void destroySwapChain(VkSwapchainKHR swapChain, const std::vector<VkImageView>& imageViews,
+        const std::vector<VkSemaphore>& renderFinishedSemaphores) const
+    {
+        for (const auto imageView : imageViews)
         {
-            if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            {
-                return VK_PRESENT_MODE_MAILBOX_KHR;
-            }
+            vkDestroyImageView(device, imageView, nullptr);
         }
 
-        return VK_PRESENT_MODE_FIFO_KHR;
-    }
+        for (const auto semaphore : renderFinishedSemaphores)
+        {
+            syncObjectPool.releaseSemaphore(semaphore);
+        }
 
-    VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities)
-    {
-        return capabilities.currentExtent;
+        vkDestroySwapchainKHR(device, swapChain, nullptr);
     }
 
     void initializeSwapChainImages()
@@ -169,20 +261,23 @@ private:
 
             checkVulkanError(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageViews.at(i)), "vkCreateImageView");
         }
+
+        renderFinishedSemaphores.clear();
+
+        for (size_t i = 0; i < swapChainImages.size(); i++)
+        {
+            renderFinishedSemaphores.push_back(syncObjectPool.acquireSemaphore());
+        }
     }
 
-    void initializeSwapChain(const VulkanSwapChainInfo& swapChainInfo, VkExtent2D& extent, const VkImageUsageFlags imageUsageFlags)
+    void initializeSwapChain(const VulkanSwapChainInfo& swapChainInfo, const VkExtent2D& extent, const VkImageUsageFlags imageUsageFlags,
+        VkSwapchainKHR oldSwapChain)
     {
         surfaceFormat = chooseSurfaceFormat(swapChainInfo.getSurfaceFormats());
-        VkPresentModeKHR presentMode = choosePresentMode(swapChainInfo.getPresentModes());
+        presentMode = presentPolicy.choosePresentMode(swapChainInfo.getPresentModes());
         VkSurfaceCapabilitiesKHR surfaceCapabilities = swapChainInfo.getSurfaceCapabilities();
         this->extent = extent;
-
-        uint32_t imageCount = surfaceCapabilities.minImageCount + 1;
-        if (surfaceCapabilities.maxImageCount > 0 && imageCount > surfaceCapabilities.maxImageCount)
-        {
-            imageCount = surfaceCapabilities.maxImageCount;
-        }
+        const uint32_t imageCount = presentPolicy.chooseImageCount(surfaceCapabilities, presentMode);
 
         VkSwapchainCreateInfoKHR swapChainCreateInfo =
         {
@@ -203,7 +298,7 @@ private:
             VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
             presentMode,
             VK_TRUE,
-            VK_NULL_HANDLE
+            oldSwapChain
         };
 
         checkVulkanError(vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapChain), "vkCreateSwapchainKHR");
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Recycles fences and binary semaphores, new objects are only created when no released ones are available. Objects may be
+// released only after the device has finished all submissions which use them.
+class VulkanSyncObjectPool
+{
+public:
+    explicit VulkanSyncObjectPool(VkDevice device) :
+        device(device),
+        createdFenceCount(0),
+        createdSemaphoreCount(0)
+    {}
+
+    ~VulkanSyncObjectPool()
+    {
+        for (const auto fence : freeFences)
+        {
+            vkDestroyFence(device, fence, nullptr);
+        }
+
+        for (const auto fence : resetFences)
+        {
+            vkDestroyFence(device, fence, nullptr);
+        }
+
+        for (const auto semaphore : freeSemaphores)
+        {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+    }
+
+    // Returned fence is unsignaled
+    VkFence acquireFence()
+    {
+        if (!resetFences.empty())
+        {
+            const VkFence fence = resetFences.back();
+            resetFences.pop_back();
+            return fence;
+        }
+
+        if (!freeFences.empty())
+        {
+            // Reset all released fences with a single call
+            checkVulkanError(vkResetFences(device, static_cast<uint32_t>(freeFences.size()), freeFences.data()), "vkResetFences");
+            resetFences.insert(resetFences.end(), freeFences.begin(), freeFences.end());
+            freeFences.clear();
+            return acquireFence();
+        }
+
+        const VkFenceCreateInfo fenceCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            nullptr,
+            0
+        };
+
+        VkFence fence;
+        checkVulkanError(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence), "vkCreateFence");
+        createdFenceCount++;
+        return fence;
+    }
+
+    // Fence may be left in any state
+    void releaseFence(VkFence fence)
+    {
+        freeFences.push_back(fence);
+    }
+
+    // Returned semaphore is unsignaled and has no pending wait operations
+    VkSemaphore acquireSemaphore()
+    {
+        if (!freeSemaphores.empty())
+        {
+            const VkSemaphore semaphore = freeSemaphores.back();
+            freeSemaphores.pop_back();
+            return semaphore;
+        }
+
+        const VkSemaphoreCreateInfo semaphoreCreateInfo =
+        {
+            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            nullptr,
+            0
+        };
+
+        VkSemaphore semaphore;
+        checkVulkanError(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore), "vkCreateSemaphore");
+        createdSemaphoreCount++;
+        return semaphore;
+    }
+
+    // Semaphore has to be unsignaled, i.e. every signal operation on it was followed by a completed wait operation
+    void releaseSemaphore(VkSemaphore semaphore)
+    {
+        freeSemaphores.push_back(semaphore);
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    uint32_t getCreatedFenceCount() const
+    {
+        return createdFenceCount;
+    }
+
+    uint32_t getCreatedSemaphoreCount() const
+    {
+        return createdSemaphoreCount;
+    }
+
+    uint32_t getFreeFenceCount() const
+    {
+        return static_cast<uint32_t>(freeFences.size() + resetFences.size());
+    }
+
+    uint32_t getFreeSemaphoreCount() const
+    {
+        return static_cast<uint32_t>(freeSemaphores.size());
+    }
+
+private:
+    VkDevice device;
+    uint32_t createdFenceCount;
+    uint32_t createdSemaphoreCount;
+    std::vector<VkFence> freeFences;
+    std::vector<VkFence> resetFences;
+    std::vector<VkSemaphore> freeSemaphores;
+};
+
+} // namespace VulkanLearning
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vulkan_barrier_batch.h"
+#include "vulkan_queue_timeline.h"
+#include "vulkan_staging_buffer.h"
+#include "vulkan_utility.h"
+
+namespace VulkanLearning
+{
+
+// Records any number of buffer copies, image copies and layout transitions into a single command buffer, which is then
+// submitted once through a queue timeline and guarded by a fence from the staging buffer. Transitions and releases are collected
+// and recorded as a single barrier right before the next copy or at submission, so preparing all images first, copying all of
+// them and releasing them afterwards costs two barriers regardless of the number of resources.
+// When the batch runs on a different queue family than the one which consumes the resources, released resources are
+// handed over with a pair of ownership transfer barriers. The release is recorded on the transfer queue, the matching
+// acquire is recorded into a second command buffer submitted to the destination queue behind the transfer timeline value.
+class VulkanTransferBatch
+{
+public:
+    explicit VulkanTransferBatch(VkDevice device, VkCommandPool commandPool, VulkanStagingBuffer& stagingBuffer) :
+        VulkanTransferBatch(device, commandPool, VK_QUEUE_FAMILY_IGNORED, stagingBuffer, VK_NULL_HANDLE, VK_QUEUE_FAMILY_IGNORED)
+    {}
+
+    explicit VulkanTransferBatch(VkDevice device, VkCommandPool commandPool, const uint32_t queueFamilyIndex, VulkanStagingBuffer& stagingBuffer,
+        VkCommandPool destinationCommandPool, const uint32_t destinationQueueFamilyIndex) :
+        device(device),
+        commandPool(commandPool),
+        queueFamilyIndex(queueFamilyIndex),
+        stagingBuffer(stagingBuffer),
+        destinationCommandPool(destinationCommandPool),
+        destinationQueueFamilyIndex(destinationQueueFamilyIndex),
+        acquireCommandBuffer(VK_NULL_HANDLE),
+        completionTimeline(nullptr),
+        completionValue(0)
+    {
+        commandBuffer = beginCommandBuffer(commandPool);
+
+        if (isOwnershipTransferred())
+        {
+            acquireCommandBuffer = beginCommandBuffer(destinationCommandPool);
+        }
+    }
+
+    ~VulkanTransferBatch()
+    {
+        if (isSubmitted())
+        {
+            wait();
+        }
+
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+        if (isOwnershipTransferred())
+        {
+            vkFreeCommandBuffers(device, destinationCommandPool, 1, &acquireCommandBuffer);
+        }
+    }
+
+    void uploadBuffer(VkBuffer destination, const void* source, const VkDeviceSize dataSize)
+    {
+        uploadBuffer(destination, 0, source, dataSize);
+    }
+
+    void uploadBuffer(VkBuffer destination, const VkDeviceSize destinationOffset, const void* source, const VkDeviceSize dataSize)
+    {
+        VulkanStagingRegion region = stagingBuffer.uploadData(source, dataSize);
+        copyBuffer(region.getBuffer(), region.getOffset(), destination, destinationOffset, dataSize);
+    }
+
+    void uploadImage(VkImage destination, const void* source, const VkDeviceSize dataSize, const VkExtent3D& imageExtent)
+    {
+        VulkanStagingRegion region = stagingBuffer.uploadData(source, dataSize);
+        copyBufferToImage(region.getBuffer(), region.getOffset(), destination, imageExtent);
+    }
+
+    void copyBuffer(VkBuffer source, const VkDeviceSize sourceOffset, VkBuffer destination, const VkDeviceSize destinationOffset,
+        const VkDeviceSize dataSize)
+    {
+        checkNotSubmitted();
+        pendingBarriers.flush(commandBuffer);
+
+        const VkBufferCopy copyRegion =
+        {
+            sourceOffset,
+            destinationOffset,
+            dataSize
+        };
+
+        vkCmdCopyBuffer(commandBuffer, source, destination, 1, &copyRegion);
+    }
+
+    // Destination image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL layout
+    void copyBufferToImage(VkBuffer source, const VkDeviceSize sourceOffset, VkImage destination, const VkExtent3D& imageExtent)
+    {
+        checkNotSubmitted();
+        pendingBarriers.flush(commandBuffer);
+
+        const VkBufferImageCopy copyRegion =
+        {
+            sourceOffset,
+            0,
+            0,
+            VkImageSubresourceLayers
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                0,
+                0,
+                1
+            },
+            VkOffset3D
+            {
+                0,
+                0,
+                0
+            },
+            imageExtent
+        };
+
+        vkCmdCopyBufferToImage(commandBuffer, source, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    }
+
+    void transitionImageLayout(VkImage image, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    {
+        checkNotSubmitted();
+        pendingBarriers.addImageTransition(image, VK_IMAGE_ASPECT_COLOR_BIT, oldLayout, newLayout);
+    }
+
+    // Makes the buffer range available to the destination queue for the given accesses, must follow all writes to the range
+    void releaseBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const VkAccessFlags destinationAccessMask,
+        const VkPipelineStageFlags destinationStageMask)
+    {
+        checkNotSubmitted();
+
+        VkBufferMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            destinationAccessMask,
+            queueFamilyIndex,
+            destinationQueueFamilyIndex,
+            buffer,
+            offset,
+            size
+        };
+
+        if (!isOwnershipTransferred())
+        {
+            pendingBarriers.addBufferBarrier(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, destinationStageMask);
+            return;
+        }
+
+        // Destination stages may not be supported by the transfer queue, the acquire barrier performs the visibility operation
+        barrier.dstAccessMask = 0;
+        pendingBarriers.addBufferBarrier(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = destinationAccessMask;
+        acquireBarriers.addBufferBarrier(barrier, destinationStageMask, destinationStageMask);
+    }
+
+    // Transitions the image into its final layout and makes it available to the destination queue
+    void releaseImage(VkImage image, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+    {
+        checkNotSubmitted();
+
+        if (!isOwnershipTransferred())
+        {
+            transitionImageLayout(image, oldLayout, newLayout);
+            return;
+        }
+
+        VkImageMemoryBarrier barrier =
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            nullptr,
+            getImageLayoutAccessMask(oldLayout),
+            0,
+            oldLayout,
+            newLayout,
+            queueFamilyIndex,
+            destinationQueueFamilyIndex,
+            image,
+            VkImageSubresourceRange
+            {
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                0,
+                1,
+                0,
+                1
+            }
+        };
+
+        pendingBarriers.addImageBarrier(barrier, getImageLayoutPipelineStage(oldLayout), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = getImageLayoutAccessMask(newLayout);
+        acquireBarriers.addImageBarrier(barrier, getImageLayoutPipelineStage(newLayout), getImageLayoutPipelineStage(newLayout));
+    }
+
+    // Returns timeline point which is reached once all transfers have finished
+    VulkanTimelinePoint submit(VulkanQueueTimeline& timeline)
+    {
+        if (isOwnershipTransferred())
+        {
+            throw std::runtime_error("Transfer batch with ownership transfer has to be submitted together with the destination queue");
+        }
+
+        submitTransfer(timeline);
+        return getCompletionPoint();
+    }
+
+    // Submits the transfer commands and the matching ownership acquire on the destination queue, neither call blocks. Returned
+    // point is reached once the released resources are owned by the destination queue family.
+    VulkanTimelinePoint submit(VulkanQueueTimeline& timeline, VulkanQueueTimeline& destinationTimeline)
+    {
+        submitTransfer(timeline);
+
+        if (!isOwnershipTransferred())
+        {
+            return getCompletionPoint();
+        }
+
+        // The semaphore wait and the acquire barrier share the same stages, forming a single dependency chain
+        const VkPipelineStageFlags waitStageMask = acquireBarriers.isEmpty() ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+            : acquireBarriers.getDestinationStageMask();
+        acquireBarriers.flush(acquireCommandBuffer);
+        checkVulkanError(vkEndCommandBuffer(acquireCommandBuffer), "vkEndCommandBuffer");
+
+        VulkanSubmission submission;
+        submission.addCommandBuffer(acquireCommandBuffer);
+        submission.waitTimeline(getCompletionPoint(), waitStageMask);
+        completionValue = destinationTimeline.submit(submission);
+        completionTimeline = &destinationTimeline;
+        return getCompletionPoint();
+    }
+
+    // Polls the completion without blocking
+    bool isComplete()
+    {
+        return isSubmitted() && completionTimeline->isComplete(completionValue);
+    }
+
+    void wait()
+    {
+        if (!isSubmitted())
+        {
+            throw std::runtime_error("Transfer batch has not been submitted yet");
+        }
+
+        completionTimeline->wait(completionValue);
+    }
+
+    bool isSubmitted() const
+    {
+        return completionTimeline != nullptr;
+    }
+
+    VulkanTimelinePoint getCompletionPoint() const
+    {
+        if (!isSubmitted())
+        {
+            throw std::runtime_error("Transfer batch has not been submitted yet");
+        }
+
+        return completionTimeline->getPoint(completionValue);
+    }
+
+    bool isOwnershipTransferred() const
+    {
+        return queueFamilyIndex != destinationQueueFamilyIndex;
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkCommandPool getCommandPool() const
+    {
+        return commandPool;
+    }
+
+    uint32_t getQueueFamilyIndex() const
+    {
+        return queueFamilyIndex;
+    }
+
+    uint32_t getDestinationQueueFamilyIndex() const
+    {
+        return destinationQueueFamilyIndex;
+    }
+
+    VkCommandBuffer getCommandBuffer() const
+    {
+        return commandBuffer;
+    }
+
+private:
+    VkDevice device;
+    VkCommandPool commandPool;
+    uint32_t queueFamilyIndex;
+    VulkanStagingBuffer& stagingBuffer;
+    VkCommandPool destinationCommandPool;
+    uint32_t destinationQueueFamilyIndex;
+    VkCommandBuffer commandBuffer;
+    VkCommandBuffer acquireCommandBuffer;
+    VulkanBarrierBatch pendingBarriers;
+    VulkanBarrierBatch acquireBarriers;
+    VulkanQueueTimeline* completionTimeline;
+    uint64_t completionValue;
+
+    VkCommandBuffer beginCommandBuffer(VkCommandPool pool) const
+    {
+        const VkCommandBufferAllocateInfo commandBufferAllocateInfo =
+        {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            nullptr,
+            pool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1
+        };
+
+        VkCommandBuffer result;
+        checkVulkanError(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &result), "vkAllocateCommandBuffers");
+
+        const VkCommandBufferBeginInfo commandBufferBeginInfo =
+        {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            nullptr
+        };
+
+        checkVulkanError(vkBeginCommandBuffer(result, &commandBufferBeginInfo), "vkBeginCommandBuffer");
+        return result;
+    }
+
+    void submitTransfer(VulkanQueueTimeline& timeline)
+    {
+        checkNotSubmitted();
+
+        // Makes all copied data visible to any work submitted to the same queue afterwards, released resources are covered by the
+        // acquire barriers instead. Pending releases are recorded together with it.
+        pendingBarriers.addMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_ACCESS_MEMORY_READ_BIT);
+        pendingBarriers.flush(commandBuffer);
+        checkVulkanError(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+
+        VulkanSubmission submission;
+        submission.addCommandBuffer(commandBuffer);
+        completionValue = timeline.submit(submission, stagingBuffer.acquireSubmissionFence());
+        completionTimeline = &timeline;
+    }
+
+    void checkNotSubmitted() const
+    {
+        if (isSubmitted())
+        {
+            throw std::runtime_error("Transfer batch has already been submitted");
+        }
+    }
+};
+
+} // namespace VulkanLearning
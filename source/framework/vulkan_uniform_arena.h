@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "vulkan/vulkan.h"
+#include "free_list_allocator.h"
+#include "vulkan_buffer.h"
+#include "vulkan_memory_allocator.h"
+
+namespace VulkanLearning
+{
+
+// Persistently mapped uniform buffer split into one region per frame. Data for a frame is bump allocated from its region
+// and addressed through dynamic offsets of a single VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor, a region may
+// only be reused once the device has finished the frame which read it.
+class VulkanUniformArena
+{
+public:
+    explicit VulkanUniformArena(VkDevice device, VulkanMemoryAllocator& allocator, const VkDeviceSize frameSize, const uint32_t frameCount,
+        const VkDeviceSize offsetAlignment) :
+        device(device),
+        frameSize(FreeListAllocator::alignOffset(frameSize, offsetAlignment)),
+        frameCount(frameCount),
+        offsetAlignment(offsetAlignment),
+        buffer(device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, this->frameSize * frameCount),
+        frameIndex(0),
+        frameOffset(0),
+        usedSize(0)
+    {
+        buffer.allocateMemory(allocator, VulkanMemoryUsage::Dynamic);
+    }
+
+    void beginFrame(const uint32_t frameIndex)
+    {
+        if (frameIndex >= frameCount)
+        {
+            throw std::runtime_error("Uniform arena frame index is out of range");
+        }
+
+        this->frameIndex = frameIndex;
+        frameOffset = getFrameOffset(frameIndex);
+        usedSize = 0;
+    }
+
+    // Returns dynamic offset of the copied data
+    uint32_t uploadData(const void* source, const VkDeviceSize dataSize)
+    {
+        const VkDeviceSize offset = FreeListAllocator::alignOffset(usedSize, offsetAlignment);
+
+        if (offset + dataSize > frameSize)
+        {
+            throw std::runtime_error("Uniform arena frame is full");
+        }
+
+        std::memcpy(static_cast<uint8_t*>(buffer.getMappedData()) + frameOffset + offset, source, dataSize);
+        usedSize = offset + dataSize;
+        return static_cast<uint32_t>(frameOffset + offset);
+    }
+
+    // Makes all data written during the frame visible to the device
+    void endFrame()
+    {
+        if (usedSize > 0)
+        {
+            buffer.flush(frameOffset, usedSize);
+        }
+    }
+
+    VkDeviceSize getFrameOffset(const uint32_t frameIndex) const
+    {
+        return frameSize * frameIndex;
+    }
+
+    VkDevice getDevice() const
+    {
+        return device;
+    }
+
+    VkBuffer getBuffer() const
+    {
+        return buffer.getBuffer();
+    }
+
+    VkDeviceSize getFrameSize() const
+    {
+        return frameSize;
+    }
+
+    uint32_t getFrameCount() const
+    {
+        return frameCount;
+    }
+
+    VkDeviceSize getOffsetAlignment() const
+    {
+        return offsetAlignment;
+    }
+
+    uint32_t getFrameIndex() const
+    {
+        return frameIndex;
+    }
+
+    VkDeviceSize getUsedSize() const
+    {
+        return usedSize;
+    }
+
+private:
+    VkDevice device;
+    VkDeviceSize frameSize;
+    uint32_t frameCount;
+    VkDeviceSize offsetAlignment;
+    VulkanBuffer buffer;
+    uint32_t frameIndex;
+    VkDeviceSize frameOffset;
+    VkDeviceSize usedSize;
+};
+
+} // namespace VulkanLearning
@@ -9,5 +9,7 @@ namespace VulkanLearning
 std::string getVulkanEnumName(const VkResult value);
 void checkVulkanError(const VkResult value);
 void checkVulkanError(const VkResult value, const std::string& message);
+VkAccessFlags getImageLayoutAccessMask(const VkImageLayout layout);
+VkPipelineStageFlags getImageLayoutPipelineStage(const VkImageLayout layout);
 
 } // namespace VulkanLearning